@@ -0,0 +1,136 @@
+// Host-native microbenchmarks for kernel/fs.c and kernel/string.c.
+// Build and run with `make host-bench`.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fs.h"
+#include "string.h"
+
+#define ROUNDS 20000
+
+static volatile long sink;   // keeps results alive across the timed loops
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, double ns, long ops) {
+    printf("host name=%s ops=%ld ns=%.0f ns_per_op=%.1f\n", name, ops, ns, ns / ops);
+}
+
+static void name_of(char *buf, char prefix, int n) {
+    buf[0] = prefix;
+    buf[1] = '0' + (n / 10) % 10;
+    buf[2] = '0' + n % 10;
+    buf[3] = '\0';
+}
+
+static void bench_find(void) {
+    char name[8];
+    int nfiles = 0;
+
+    fs_init();
+    for (int i = 0; i < MAX_FILES; i++) {
+        name_of(name, 'f', i);
+        if (fs_create(name, TYPE_FILE) >= 0) nfiles++;
+    }
+
+    // Hit the last-created name (full scan) and a missing one
+    name_of(name, 'f', nfiles - 1);
+    double t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        sink += fs_find(name);
+    }
+    report("fs_find_hit", now_ns() - t, ROUNDS);
+
+    t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        sink += fs_find("missing");
+    }
+    report("fs_find_miss", now_ns() - t, ROUNDS);
+}
+
+static void bench_create(void) {
+    char name[8];
+    long ops = 0;
+    double t, total = 0;
+
+    for (int r = 0; r < ROUNDS / MAX_FILES; r++) {
+        fs_init();
+        t = now_ns();
+        for (int i = 0; i < MAX_FILES; i++) {
+            name_of(name, 'c', i);
+            sink += fs_create(name, TYPE_FILE);
+            ops++;
+        }
+        total += now_ns() - t;
+    }
+    report("fs_create", total, ops);
+}
+
+static void bench_write(void) {
+    static const uint32_t sizes[] = { 16, 128, MAX_FILE_SIZE };
+    static char buf[MAX_FILE_SIZE];
+    char name[32];
+
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = 'a' + i % 26;
+    }
+
+    fs_init();
+    fs_create("w", TYPE_FILE);
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double t = now_ns();
+        for (int r = 0; r < ROUNDS; r++) {
+            sink += fs_write("w", buf, sizes[s]);
+        }
+        snprintf(name, sizeof(name), "fs_write_%u", sizes[s]);
+        report(name, now_ns() - t, ROUNDS);
+
+        t = now_ns();
+        for (int r = 0; r < ROUNDS; r++) {
+            sink += fs_read("w", buf, sizes[s]);
+        }
+        snprintf(name, sizeof(name), "fs_read_%u", sizes[s]);
+        report(name, now_ns() - t, ROUNDS);
+    }
+}
+
+static void bench_string(void) {
+    static char a[MAX_PATH], b[MAX_PATH];
+
+    for (int i = 0; i < MAX_PATH - 1; i++) {
+        a[i] = b[i] = 'a' + i % 26;
+    }
+
+    double t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        sink += strcmp(a, b);
+    }
+    report("strcmp_127", now_ns() - t, ROUNDS);
+
+    t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        sink += strlen(a);
+    }
+    report("strlen_127", now_ns() - t, ROUNDS);
+
+    t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        strncpy(b, a, MAX_FILENAME);
+        sink += b[0];
+    }
+    report("strncpy_32", now_ns() - t, ROUNDS);
+}
+
+int main(void) {
+    bench_find();
+    bench_create();
+    bench_write();
+    bench_string();
+    return 0;
+}
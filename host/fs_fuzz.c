@@ -0,0 +1,377 @@
+// Fuzz target for kernel/fs.c: decodes the input into a sequence of fs
+// operations, replays them against a simple reference model, and aborts
+// on the first divergence. Build with `make host-fuzz`.
+//
+// With clang, FUZZ_ENGINE=-fsanitize=fuzzer links libFuzzer and uses
+// LLVMFuzzerTestOneInput directly. Otherwise the main() below either
+// replays input files (AFL-style: fs_fuzz @@) or runs random inputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fs.h"
+#include "string.h"
+#include "lz.h"
+
+static const char *names[] = { "a", "b", "c", "dir", "/", ".", "..", "e" };
+#define NNAMES (sizeof(names) / sizeof(names[0]))
+
+// Reference model, indexed like inodes[] (lowest free slot first)
+struct model_node {
+    int used;
+    char name[MAX_FILENAME];
+    file_type_t type;
+    int parent;
+    uint32_t size;
+    char data[MAX_FILE_SIZE];
+};
+
+static struct model_node model[MAX_FILES];
+static int model_cwd;
+
+#define CHECK(cond, what)                                               \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "fs_fuzz: %s (%s:%d)\n", what, __FILE__, __LINE__); \
+            abort();                                                    \
+        }                                                               \
+    } while (0)
+
+static int model_find(const char *path) {
+    if (strcmp(path, "/") == 0) return 0;
+    if (strcmp(path, ".") == 0) return model_cwd;
+    if (strcmp(path, "..") == 0) return model_cwd == 0 ? 0 : model[model_cwd].parent;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (model[i].used && model[i].parent == model_cwd &&
+            strcmp(model[i].name, path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int model_create(const char *path, file_type_t type) {
+    if (model_find(path) >= 0) return -1;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!model[i].used) {
+            model[i].used = 1;
+            strcpy(model[i].name, path);
+            model[i].type = type;
+            model[i].parent = model_cwd;
+            model[i].size = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int model_delete(const char *path) {
+    int idx = model_find(path);
+    if (idx <= 0 || idx == model_cwd) return -1;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (model[i].used && model[i].parent == idx) return -1;
+    }
+    model[idx].used = 0;
+    return 0;
+}
+
+static int model_is_ancestor(int a, int b) {
+    while (a != b) {
+        if (b == 0) return 0;
+        b = model[b].parent;
+    }
+    return 1;
+}
+
+static int model_subtree(int idx) {
+    int n = 1;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (model[idx].type == TYPE_DIR && model[i].used && model[i].parent == idx && i != idx) {
+            n += model_subtree(i);
+        }
+    }
+    return n;
+}
+
+// Same allocation order as copy_inode(): node first, then children by index
+static int model_copy_node(int src, int parent, const char *name) {
+    int idx = 0;
+    while (model[idx].used) idx++;
+    model[idx] = model[src];
+    strcpy(model[idx].name, name);
+    model[idx].parent = parent;
+    if (model[src].type == TYPE_DIR) {
+        for (int i = 0; i < MAX_FILES; i++) {
+            if (model[i].used && model[i].parent == src && i != src) {
+                model_copy_node(i, idx, model[i].name);
+            }
+        }
+    }
+    return idx;
+}
+
+static int model_copy(const char *src, const char *dst, int recursive) {
+    int idx = model_find(src);
+    if (idx < 0 || model_find(dst) >= 0) return -1;
+    if (model[idx].type == TYPE_DIR && (!recursive || model_is_ancestor(idx, model_cwd))) return -1;
+    int free_nodes = 0;
+    for (int i = 0; i < MAX_FILES; i++) free_nodes += !model[i].used;
+    if (model_subtree(idx) > free_nodes) return -1;
+    return model_copy_node(idx, model_cwd, dst);
+}
+
+static void model_reset(void) {
+    static const char *initial[] = { "welcome.txt", "hello.sh", "test.txt" };
+
+    for (int i = 0; i < MAX_FILES; i++) model[i].used = 0;
+    model[0].used = 1;
+    strcpy(model[0].name, "/");
+    model[0].type = TYPE_DIR;
+    model[0].parent = 0;
+    model[0].size = 0;
+    model_cwd = 0;
+
+    // Mirror the files fs_init() creates by copying them out of the fs
+    for (unsigned i = 0; i < sizeof(initial) / sizeof(initial[0]); i++) {
+        int idx = model_create(initial[i], TYPE_FILE);
+        CHECK(idx == fs_find(initial[i]), "initial file layout");
+        model[idx].size = fs_read(initial[i], model[idx].data, MAX_FILE_SIZE);
+    }
+}
+
+static int list_count;
+static void count_entry(const char *name, file_type_t type, uint32_t size) {
+    (void)name;
+    (void)type;
+    (void)size;
+    list_count++;
+}
+
+// Compare every inode and directory listing with the model
+static void check_invariants(void) {
+    CHECK(fs_check() == 0, "fs_check");
+    CHECK(fs_get_cwd() == model_cwd, "cwd");
+    for (int i = 0; i < MAX_FILES; i++) {
+        const char *name = fs_get_name(i);
+        CHECK((name != NULL) == (model[i].used != 0), "inode in use");
+        if (!model[i].used) continue;
+        CHECK(strcmp(name, model[i].name) == 0, "inode name");
+        CHECK(fs_get_type(i) == model[i].type, "inode type");
+        CHECK(fs_get_size(i) == model[i].size, "inode size");
+        if (model[i].type != TYPE_DIR) continue;
+
+        int children = 0;
+        for (int j = 0; j < MAX_FILES; j++) {
+            if (model[j].used && model[j].parent == i) children++;
+        }
+        list_count = 0;
+        CHECK(fs_list(i, count_entry) == children, "fs_list result");
+        CHECK(list_count == children, "fs_list callbacks");
+    }
+}
+
+// Codec: arbitrary input must never overrun, and must round-trip
+static void check_lz(const uint8_t *data, size_t size) {
+    static uint8_t z[8192], out[4096];
+    int n = size < sizeof(out) ? (int)size : (int)sizeof(out);
+
+    lz_decompress(data, n, out, data[0] * 16);
+
+    int zlen = lz_compress(data, n, z, sizeof(z));
+    CHECK(zlen >= 0, "lz_compress");
+    CHECK(lz_decompress(z, zlen, out, n) == n, "lz round-trip size");
+    for (int i = 0; i < n; i++) {
+        CHECK(out[i] == data[i], "lz round-trip data");
+    }
+}
+
+static void run_ops(const uint8_t *data, size_t size) {
+    static char buf[MAX_FILE_SIZE + 64];
+    static char out[MAX_FILE_SIZE + 64];
+    size_t pos = 0;
+
+    if (size > 0) {
+        check_lz(data, size);
+    }
+
+    fs_init();
+    model_reset();
+    check_invariants();
+
+    while (pos + 2 <= size) {
+        uint8_t op = data[pos++];
+        const char *name = names[data[pos++] % NNAMES];
+        int kind = op % 11;
+        int idx, expect;
+
+        switch (kind) {
+        case 0:
+        case 1: {
+            file_type_t type = kind ? TYPE_DIR : TYPE_FILE;
+            expect = model_create(name, type);
+            CHECK(fs_create(name, type) == expect, "fs_create");
+            break;
+        }
+        case 2:
+        case 3: {
+            // Length up to MAX_FILE_SIZE + 63 to exercise clamping
+            uint32_t len = pos < size ? (data[pos++] * 4u) % (MAX_FILE_SIZE + 64) : 0;
+            // High op bit: compressible text instead of input bytes
+            for (uint32_t i = 0; i < len; i++) {
+                buf[i] = (!(op & 0x80) && pos < size) ? (char)data[pos++] : (char)('a' + i % 7);
+            }
+            idx = model_find(name);
+            expect = -1;
+            if (idx >= 0 && model[idx].type == TYPE_FILE) {
+                uint32_t base = (kind == 3) ? model[idx].size : 0;
+                uint32_t n = len;
+                if (n > MAX_FILE_SIZE - base) n = MAX_FILE_SIZE - base;
+                for (uint32_t i = 0; i < n; i++) model[idx].data[base + i] = buf[i];
+                model[idx].size = base + n;
+                expect = n;
+            }
+            if (kind == 3) {
+                CHECK(fs_append(name, buf, len) == expect, "fs_append");
+            } else {
+                CHECK(fs_write(name, buf, len) == expect, "fs_write");
+            }
+            break;
+        }
+        case 4:
+            idx = model_find(name);
+            expect = (idx >= 0 && model[idx].type == TYPE_FILE) ? (int)model[idx].size : -1;
+            CHECK(fs_read(name, out, sizeof(out)) == expect, "fs_read size");
+            for (int i = 0; i < expect; i++) {
+                CHECK(out[i] == model[idx].data[i], "fs_read data");
+            }
+            break;
+        case 5:
+            expect = model_delete(name);
+            CHECK(fs_delete(name) == expect, "fs_delete");
+            break;
+        case 6:
+            idx = model_find(name);
+            CHECK(fs_find(name) == idx, "fs_find");
+            if (idx >= 0 && model[idx].type == TYPE_DIR) model_cwd = idx;
+            fs_set_cwd(idx);
+            break;
+        case 7:
+            model_cwd = 0;
+            fs_set_cwd(0);
+            break;
+        case 8:
+            // Switch compression mode (off/on/auto); contents must not change
+            idx = model_find(name);
+            expect = (idx >= 0 && model[idx].type == TYPE_FILE) ? 0 : -1;
+            CHECK(fs_set_compress(name, pos < size ? data[pos++] % 3 : 0) == expect,
+                  "fs_set_compress");
+            if (expect == 0) {
+                CHECK(fs_read(name, out, sizeof(out)) == (int)model[idx].size, "repacked size");
+                for (uint32_t i = 0; i < model[idx].size; i++) {
+                    CHECK(out[i] == model[idx].data[i], "repacked data");
+                }
+            }
+            break;
+        case 9: {
+            // cp / cp -r to a second name; later writes exercise COW
+            const char *dst = names[(pos < size ? data[pos++] : 0) % NNAMES];
+            int recursive = op & 0x80;
+            expect = model_copy(name, dst, recursive);
+            CHECK(fs_copy(name, dst, recursive) == expect, "fs_copy");
+            break;
+        }
+        case 10:
+            fs_dedup();
+            break;
+        }
+        check_invariants();
+    }
+
+    // A warm reboot must reattach, with every context back at the root
+    fs_persist_seal();
+    CHECK(fs_init() == 1, "sealed state rejected");
+    model_cwd = 0;
+    check_invariants();
+}
+
+// Fill every free inode with an incompressible packed file, the worst
+// case for the block pool, then rewrite them all. No write may fail or
+// disturb another file's contents.
+static void check_full_pool(void) {
+    static char data[MAX_FILES][MAX_FILE_SIZE];
+    static char out[MAX_FILE_SIZE];
+    char name[4] = { 'p', 0, 0, 0 };
+    int nfiles = 0;
+
+    fs_init();
+    fs_delete("welcome.txt");
+    fs_delete("hello.sh");
+    fs_delete("test.txt");
+    fs_set_default_compress(FS_COMPRESS_ON);
+    for (int round = 0; round < 2; round++) {
+        for (int f = 0; f < MAX_FILES; f++) {
+            name[1] = 'a' + f;
+            if (round == 0 && fs_create(name, TYPE_FILE) < 0) break;
+            if (round == 0) nfiles = f + 1;
+            if (f >= nfiles) break;
+            for (int i = 0; i < MAX_FILE_SIZE; i++) data[f][i] = (char)rand();
+            CHECK(fs_write(name, data[f], MAX_FILE_SIZE) == MAX_FILE_SIZE, "full pool write");
+        }
+        for (int f = 0; f < nfiles; f++) {
+            name[1] = 'a' + f;
+            CHECK(fs_read(name, out, sizeof(out)) == MAX_FILE_SIZE, "full pool read size");
+            for (int i = 0; i < MAX_FILE_SIZE; i++) {
+                CHECK(out[i] == data[f][i], "full pool read data");
+            }
+        }
+        CHECK(fs_check() == 0, "full pool fs_check");
+    }
+    fs_set_default_compress(FS_COMPRESS_OFF);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    run_ops(data, size);
+    return 0;
+}
+
+#ifndef FS_FUZZ_LIBFUZZER
+// Usage: fs_fuzz [file...]          replay inputs (AFL: fs_fuzz @@)
+//        fs_fuzz -n ITERS [-s SEED] random inputs
+int main(int argc, char **argv) {
+    static uint8_t input[4096];
+    long iters = 0;
+    unsigned seed = 1;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] == 'n' && i + 1 < argc) {
+            iters = atol(argv[++i]);
+        } else if (argv[i][0] == '-' && argv[i][1] == 's' && i + 1 < argc) {
+            seed = (unsigned)atol(argv[++i]);
+        } else {
+            FILE *f = fopen(argv[i], "rb");
+            if (!f) {
+                perror(argv[i]);
+                return 1;
+            }
+            size_t n = fread(input, 1, sizeof(input), f);
+            fclose(f);
+            run_ops(input, n);
+            files++;
+        }
+    }
+
+    if (files == 0) {
+        if (iters == 0) iters = 10000;
+        srand(seed);
+        check_full_pool();
+        for (long it = 0; it < iters; it++) {
+            size_t n = 2 + rand() % (sizeof(input) - 2);
+            for (size_t i = 0; i < n; i++) input[i] = (uint8_t)rand();
+            run_ops(input, n);
+        }
+        printf("fs_fuzz: %ld random inputs, seed %u, no divergence\n", iters, seed);
+    }
+    return 0;
+}
+#endif
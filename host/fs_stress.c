@@ -0,0 +1,62 @@
+// Runs the kernel's fsstress workload (kernel/fsstress.c) with threads
+// standing in for harts, repeatedly, and fails on the first run that
+// breaks an invariant. Build and run with `make host-stress`.
+//
+// A fast interval timer makes whichever thread it interrupts yield, so
+// threads switch at arbitrary points even on a single host CPU.
+
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "fs.h"
+#include "fsstress.h"
+#include "param.h"
+
+static void preempt(int sig) {
+    (void)sig;
+    sched_yield();
+}
+
+static void start_preemption(long usec) {
+    struct sigaction sa = { .sa_handler = preempt, .sa_flags = SA_RESTART };
+    struct itimerval it = { { 0, usec }, { 0, usec } };
+    sigaction(SIGALRM, &sa, NULL);
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+// Usage: fs_stress [RUNS [ROUNDS]]
+int main(int argc, char **argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 50;
+    int rounds = argc > 2 ? atoi(argv[2]) : 200;
+    struct fsstress_result res;
+    uint64_t ops = 0, shared = 0;
+
+    fs_init();
+    start_preemption(50);
+    for (int i = 0; i < runs; i++) {
+        if (fsstress_run(NCPU, rounds, &res) < 0) {
+            fprintf(stderr, "fs_stress: run %d: cannot create test directory\n", i);
+            return 1;
+        }
+        if (res.errors || res.leftover || res.check || res.leaked) {
+            fprintf(stderr, "fs_stress: run %d: errors=%u leftover=%d check=%d leaked=%u\n",
+                    i, res.errors, res.leftover, res.check, res.leaked);
+            return 1;
+        }
+        ops += res.ops;
+        shared += res.shared;
+    }
+
+    // The filesystem must still be fit to seal and reattach
+    fs_persist_seal();
+    if (fs_init() != 1) {
+        fprintf(stderr, "fs_stress: sealed state rejected\n");
+        return 1;
+    }
+    printf("fs_stress: %d runs x %d workers x %d rounds, %lu ops, %lu contended creates won, ok\n",
+           runs, NCPU, rounds, (unsigned long)ops, (unsigned long)shared);
+    return 0;
+}
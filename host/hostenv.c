@@ -0,0 +1,68 @@
+// Kernel symbols that fs.c expects, for host builds
+#include <pthread.h>
+#include <time.h>
+
+#include "trace.h"
+#include "perf.h"
+#include "fs.h"
+#include "hart.h"
+#include "param.h"
+
+volatile uint32_t trace_mask;
+
+void trace_record(uint32_t event, uint32_t phase, uint32_t arg0, uint64_t arg1) {
+    (void)event;
+    (void)phase;
+    (void)arg0;
+    (void)arg1;
+}
+
+// Nanoseconds stand in for cycles on the host
+uint64_t perf_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// Each thread is a context, as each hart is in the kernel
+static __thread fs_context_t context;
+
+fs_context_t *fs_context(void) {
+    return &context;
+}
+
+// Secondary "harts" are threads
+struct host_hart {
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+    int busy;
+};
+
+static struct host_hart harts[NCPU];
+
+static void *hart_main(void *p) {
+    struct host_hart *h = p;
+    h->fn(h->arg);
+    return NULL;
+}
+
+int hart_start(int id, void (*fn)(void *), void *arg) {
+    if (id <= 0 || id >= NCPU || harts[id].busy) {
+        return -1;
+    }
+    harts[id].fn = fn;
+    harts[id].arg = arg;
+    if (pthread_create(&harts[id].thread, NULL, hart_main, &harts[id]) != 0) {
+        return -1;
+    }
+    harts[id].busy = 1;
+    return 0;
+}
+
+void hart_wait(int id) {
+    if (id > 0 && id < NCPU && harts[id].busy) {
+        pthread_join(harts[id].thread, NULL);
+        harts[id].busy = 0;
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef KCOMPAT_H
+#define KCOMPAT_H
+
+// Force-included into every host-built file: the kernel's string routines
+// share names (but not all signatures) with libc, so give them their own.
+#define strcmp  kstrcmp
+#define strncmp kstrncmp
+#define strlen  kstrlen
+#define strcpy  kstrcpy
+#define strncpy kstrncpy
+
+#endif
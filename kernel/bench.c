@@ -0,0 +1,378 @@
+#include "bench.h"
+#include "fs.h"
+#include "riscv.h"
+#include "string.h"
+#include "console.h"
+#include "virtio_console.h"
+
+#define BENCH_DIR     "bench.tmp"
+#define STORM_FILES   16     // files per create/lookup/delete round
+#define STORM_ROUNDS  50
+#define SEQ_ROUNDS    200
+#define WALK_DEPTH    16
+#define WALK_ROUNDS   100
+#define CONS_LINE     64     // consbench tx line length, '\n' included
+
+// Cycles and timer ticks accumulated over the timed sections of a test
+struct bench_timer {
+    uint64_t cycles;
+    uint64_t ticks;
+    uint64_t cycle0;
+    uint64_t time0;
+};
+
+static void timer_start(struct bench_timer *t) {
+    t->time0 = r_time();
+    t->cycle0 = r_mcycle();
+}
+
+static void timer_stop(struct bench_timer *t) {
+    t->cycles += r_mcycle() - t->cycle0;
+    t->ticks += r_time() - t->time0;
+}
+
+// Print one result line for ops operations
+static void bench_report(const char *name, const struct bench_timer *t, uint64_t ops) {
+    console_puts("bench name=");
+    console_puts(name);
+    console_puts(" ops=");
+    console_putdec(ops);
+    console_puts(" cycles=");
+    console_putdec(t->cycles);
+    console_puts(" cycles_per_op=");
+    console_putdec(ops ? t->cycles / ops : 0);
+    console_puts(" us=");
+    console_putdec(t->ticks * 1000000UL / TIMEBASE_HZ);
+    console_putc('\n');
+}
+
+// Helper: Build "<prefix><n>" into buf
+static void bench_name(char *buf, char prefix, int n) {
+    buf[0] = prefix;
+    buf[1] = '0' + (n / 10) % 10;
+    buf[2] = '0' + n % 10;
+    buf[3] = '\0';
+}
+
+static int selected(const char *filter, const char *name) {
+    return strncmp(name, filter, strlen(filter)) == 0;
+}
+
+static int bench_failed;   // Some test could not run as intended
+
+// Helper: Report a test whose operations failed. Its timings would be
+// of failing calls, so it prints no result line and benchcmp sees it
+// as missing.
+static void bench_fail(const char *name, const char *what) {
+    console_puts("bench: ");
+    console_puts(name);
+    console_puts(": ");
+    console_puts(what);
+    console_putc('\n');
+    bench_failed = 1;
+}
+
+// fs_list callback for remove_tree: remember one entry of the directory
+static char first_entry[MAX_FILENAME];
+static void note_entry(const char *name, file_type_t type, uint32_t size) {
+    (void)type;
+    (void)size;
+    strncpy(first_entry, name, MAX_FILENAME - 1);
+    first_entry[MAX_FILENAME - 1] = '\0';
+}
+
+// Helper: Delete name in the cwd and everything under it. fs_delete only
+// takes empty directories, so walk down to a leaf, delete it, and start
+// over from the top. -1 if something cannot be removed (a job's cwd).
+static int remove_tree(const char *name) {
+    int top = fs_get_cwd();
+    char cur[MAX_FILENAME];
+    int ret = 0;
+
+    while (fs_find(name) >= 0) {
+        strcpy(cur, name);
+        while (fs_delete(cur) < 0) {
+            int idx = fs_find(cur);
+            if (fs_get_type(idx) != TYPE_DIR || fs_list(idx, note_entry) <= 0) {
+                ret = -1;
+                break;
+            }
+            fs_set_cwd(idx);
+            strcpy(cur, first_entry);
+        }
+        fs_set_cwd(top);
+        if (ret < 0) break;
+    }
+    return ret;
+}
+
+// create/lookup/delete storms over STORM_FILES names
+static void bench_storm(const char *filter) {
+    struct bench_timer create = {0}, lookup = {0}, delete = {0};
+    int errors = 0;
+    char name[8];
+
+    if (!selected(filter, "storm")) {
+        return;
+    }
+
+    for (int r = 0; r < STORM_ROUNDS; r++) {
+        timer_start(&create);
+        for (int i = 0; i < STORM_FILES; i++) {
+            bench_name(name, 'f', i);
+            errors += fs_create(name, TYPE_FILE) < 0;
+        }
+        timer_stop(&create);
+
+        timer_start(&lookup);
+        for (int i = 0; i < STORM_FILES; i++) {
+            bench_name(name, 'f', i);
+            errors += fs_find(name) < 0;
+        }
+        timer_stop(&lookup);
+
+        timer_start(&delete);
+        for (int i = 0; i < STORM_FILES; i++) {
+            bench_name(name, 'f', i);
+            errors += fs_delete(name) < 0;
+        }
+        timer_stop(&delete);
+    }
+
+    if (errors) {
+        bench_fail("storm", "fs operations failed (inode table full?)");
+        return;
+    }
+    bench_report("storm_create", &create, STORM_ROUNDS * STORM_FILES);
+    bench_report("storm_lookup", &lookup, STORM_ROUNDS * STORM_FILES);
+    bench_report("storm_delete", &delete, STORM_ROUNDS * STORM_FILES);
+}
+
+// Sequential write, append and read at one file size
+static void bench_seq(const char *filter, const char *wname, const char *aname,
+                      const char *rname, uint32_t size) {
+    static char buf[MAX_FILE_SIZE];
+    struct bench_timer t = {0};
+
+    for (uint32_t i = 0; i < size; i++) {
+        buf[i] = 'a' + i % 26;
+    }
+    if (fs_create("seq", TYPE_FILE) < 0) {
+        bench_fail(wname, "cannot create the test file");
+        return;
+    }
+
+    if (selected(filter, wname)) {
+        int errors = 0;
+        timer_start(&t);
+        for (int r = 0; r < SEQ_ROUNDS; r++) {
+            errors += fs_write("seq", buf, size) != (int)size;
+        }
+        timer_stop(&t);
+        if (errors) {
+            bench_fail(wname, "short write");
+        } else {
+            bench_report(wname, &t, SEQ_ROUNDS);
+        }
+    }
+
+    // Grow the file 16 bytes at a time, starting empty each round
+    if (selected(filter, aname)) {
+        uint64_t ops = 0;
+        int errors = 0;
+        t.cycles = t.ticks = 0;
+        for (int r = 0; r < SEQ_ROUNDS / 10; r++) {
+            fs_write("seq", buf, 0);
+            timer_start(&t);
+            for (uint32_t off = 0; off < size; off += 16) {
+                errors += fs_append("seq", buf + off, size - off < 16 ? size - off : 16) < 0;
+                ops++;
+            }
+            timer_stop(&t);
+        }
+        if (errors || fs_get_size(fs_find("seq")) != size) {
+            bench_fail(aname, "short append");
+        } else {
+            bench_report(aname, &t, ops);
+        }
+    }
+
+    if (selected(filter, rname)) {
+        int errors = fs_write("seq", buf, size) != (int)size;
+        t.cycles = t.ticks = 0;
+        timer_start(&t);
+        for (int r = 0; r < SEQ_ROUNDS; r++) {
+            errors += fs_read("seq", buf, size) != (int)size;
+        }
+        timer_stop(&t);
+        if (errors) {
+            bench_fail(rname, "short read");
+        } else {
+            bench_report(rname, &t, SEQ_ROUNDS);
+        }
+    }
+
+    fs_delete("seq");
+}
+
+// Walk a WALK_DEPTH-deep chain of directories from top to bottom
+static void bench_walk(const char *filter) {
+    struct bench_timer t = {0};
+    int levels[WALK_DEPTH + 1];
+    char name[8];
+    int depth;
+
+    if (!selected(filter, "dir_walk")) {
+        return;
+    }
+
+    levels[0] = fs_get_cwd();
+    for (depth = 0; depth < WALK_DEPTH; depth++) {
+        bench_name(name, 'd', depth);
+        int idx = fs_create(name, TYPE_DIR);
+        if (idx < 0) break;
+        fs_set_cwd(idx);
+        levels[depth + 1] = idx;
+    }
+
+    // A shorter chain would be a different test
+    int errors = depth < WALK_DEPTH;
+    if (!errors) {
+        timer_start(&t);
+        for (int r = 0; r < WALK_ROUNDS; r++) {
+            fs_set_cwd(levels[0]);
+            for (int i = 0; i < depth; i++) {
+                bench_name(name, 'd', i);
+                fs_set_cwd(fs_find(name));
+            }
+            errors += fs_get_cwd() != levels[depth];
+        }
+        timer_stop(&t);
+    }
+    if (errors) {
+        bench_fail("dir_walk", depth < WALK_DEPTH ? "cannot create the directory chain"
+                                                  : "walk did not reach the bottom");
+    } else {
+        bench_report("dir_walk", &t, (uint64_t)WALK_ROUNDS * depth);
+    }
+
+    // Remove the chain bottom-up
+    for (int i = depth - 1; i >= 0; i--) {
+        fs_set_cwd(levels[i]);
+        bench_name(name, 'd', i);
+        fs_delete(name);
+    }
+    fs_set_cwd(levels[0]);
+}
+
+void bench_run(const char *filter) {
+    int saved_cwd = fs_get_cwd();
+
+    // Work in a scratch directory under / so user files are untouched.
+    // A run that was cut short may have left one behind.
+    fs_set_cwd(0);
+    int dir = -1;
+    if (remove_tree(BENCH_DIR) == 0) {
+        dir = fs_create(BENCH_DIR, TYPE_DIR);
+    }
+    if (dir < 0) {
+        console_puts("bench: cannot create /" BENCH_DIR "\n");
+        console_puts("bench FAILED\n");
+        fs_set_cwd(saved_cwd);
+        return;
+    }
+    fs_set_cwd(dir);
+    bench_failed = 0;
+
+    bench_storm(filter);
+    bench_seq(filter, "write_16", "append_16", "read_16", 16);
+    bench_seq(filter, "write_128", "append_128", "read_128", 128);
+    bench_seq(filter, "write_1024", "append_1024", "read_1024", MAX_FILE_SIZE);
+    bench_walk(filter);
+
+    fs_set_cwd(0);
+    if (remove_tree(BENCH_DIR) < 0) {
+        bench_fail("cleanup", "cannot remove /" BENCH_DIR);
+    }
+    fs_set_cwd(saved_cwd);
+    console_puts(bench_failed ? "bench FAILED\n" : "bench done\n");
+}
+
+// Helper: Append "<prefix><backend>" for a per-backend result name
+static void cons_name(char *buf, const char *prefix) {
+    strcpy(buf, prefix);
+    strcpy(buf + strlen(prefix), console_backend());
+}
+
+// Helper: Byte k of the consbench tx stream: CONS_LINE-byte lines of one
+// letter each, so the host can check what arrived
+static char cons_byte(uint64_t k) {
+    if (k % CONS_LINE == CONS_LINE - 1) {
+        return '\n';
+    }
+    return 'a' + (k / CONS_LINE) % 26;
+}
+
+// Console throughput through whichever backend console_init() picked.
+// rx reads BYTES raw input bytes (no echo) and prints their FNV-1a hash;
+// tx writes BYTES of text a line at a time, as cat does.
+// Usage: consbench rx|tx BYTES (tools/consbench.py drives both)
+void bench_console(const char *args) {
+    struct bench_timer t = {0};
+    struct virtcons_stats before, after;
+    char name[32];
+    int rx = strncmp(args, "rx ", 3) == 0;
+    uint64_t bytes = 0;
+
+    if (!rx && strncmp(args, "tx ", 3) != 0) {
+        console_puts("Usage: consbench rx|tx BYTES\n");
+        return;
+    }
+    for (const char *p = args + 3; *p >= '0' && *p <= '9'; p++) {
+        bytes = bytes * 10 + (*p - '0');
+    }
+
+    virtcons_get_stats(&before);
+    if (rx) {
+        uint32_t hash = 2166136261u;
+        timer_start(&t);
+        for (uint64_t i = 0; i < bytes; i++) {
+            hash = (hash ^ (unsigned char)console_getc()) * 16777619u;
+        }
+        timer_stop(&t);
+        cons_name(name, "cons_rx_");
+        bench_report(name, &t, bytes);
+        console_puts("consbench rx hash=");
+        console_putx(hash);
+    } else {
+        char line[CONS_LINE + 1];
+        int n = 0;
+        console_puts("consbench tx begin\n");
+        console_flush();
+        timer_start(&t);
+        for (uint64_t i = 0; i < bytes; i++) {
+            line[n++] = cons_byte(i);
+            if (n == CONS_LINE || i == bytes - 1) {
+                line[n] = '\0';
+                console_puts(line);
+                n = 0;
+            }
+        }
+        console_flush();
+        timer_stop(&t);
+        console_puts("\nconsbench tx end\n");
+        cons_name(name, "cons_tx_");
+        bench_report(name, &t, bytes);
+        console_puts("consbench tx");
+    }
+    virtcons_get_stats(&after);
+    console_puts(" backend=");
+    console_puts(console_backend());
+    console_puts(" bytes=");
+    console_putdec(bytes);
+    console_puts(" bufs=");
+    console_putdec(rx ? after.rx_bufs - before.rx_bufs : after.tx_bufs - before.tx_bufs);
+    console_puts(" kicks=");
+    console_putdec(rx ? after.rx_kicks - before.rx_kicks : after.tx_kicks - before.tx_kicks);
+    console_putc('\n');
+}
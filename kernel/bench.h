@@ -0,0 +1,15 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Filesystem benchmark suite. Prints one line per test:
+//   bench name=<test> ops=<n> cycles=<total> cycles_per_op=<n> us=<n>
+// Runs every test whose name starts with filter (all if empty). A test
+// whose operations fail prints "bench: <test>: <reason>" instead, and
+// the run ends with "bench FAILED" rather than "bench done".
+void bench_run(const char *filter);
+
+// Console throughput: consbench rx|tx BYTES, reported as
+// cons_rx_<backend> / cons_tx_<backend> plus a "consbench ..." summary
+void bench_console(const char *args);
+
+#endif
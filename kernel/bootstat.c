@@ -0,0 +1,54 @@
+#include "bootstat.h"
+#include "riscv.h"
+#include "console.h"
+#include "string.h"
+
+static uint64_t boot_times[BOOT_NPHASES];
+
+static const char *phase_names[BOOT_NPHASES] = {
+    "entry", "bss", "trap", "console", "fs", "prompt"
+};
+
+// Convert timer ticks to microseconds
+static uint64_t ticks_to_us(uint64_t ticks) {
+    return ticks * 1000000UL / TIMEBASE_HZ;
+}
+
+// entry.S reads the timer before clearing .bss, then hands it over here
+void bootstat_entry(uint64_t entry_time) {
+    boot_times[BOOT_ENTRY] = entry_time;
+    boot_times[BOOT_BSS] = r_time();
+}
+
+// Record the completion time of a boot phase
+void bootstat_mark(int phase) {
+    if (phase >= 0 && phase < BOOT_NPHASES) {
+        boot_times[phase] = r_time();
+    }
+}
+
+// bootstat - print per-phase timestamps relative to _start
+void bootstat_print(void) {
+    uint64_t start = boot_times[BOOT_ENTRY];
+    uint64_t prev = start;
+
+    console_puts("phase     at(us)  delta(us)\n");
+    for (int i = 0; i < BOOT_NPHASES; i++) {
+        uint64_t t = boot_times[i];
+        console_puts("  ");
+        console_puts(phase_names[i]);
+        for (unsigned long pad = strlen(phase_names[i]); pad < 8; pad++) {
+            console_putc(' ');
+        }
+        console_putdec(ticks_to_us(t - start));
+        console_puts("  +");
+        console_putdec(ticks_to_us(t - prev));
+        console_putc('\n');
+        prev = t;
+    }
+    console_puts("boot-to-prompt: ");
+    console_putdec(ticks_to_us(boot_times[BOOT_PROMPT] - start));
+    console_puts(" us (");
+    console_putdec(boot_times[BOOT_PROMPT] - start);
+    console_puts(" ticks)\n");
+}
@@ -0,0 +1,21 @@
+#ifndef BOOTSTAT_H
+#define BOOTSTAT_H
+
+#include "types.h"
+
+// Boot phases, in the order they complete
+enum boot_phase {
+    BOOT_ENTRY,    // first instruction of _start
+    BOOT_BSS,      // .bss cleared, stack ready
+    BOOT_TRAP,     // mtvec installed
+    BOOT_CONSOLE,  // console ready
+    BOOT_FS,       // filesystem ready
+    BOOT_PROMPT,   // first prompt printed
+    BOOT_NPHASES
+};
+
+void bootstat_entry(uint64_t entry_time);  // called from entry.S
+void bootstat_mark(int phase);
+void bootstat_print(void);
+
+#endif
@@ -1,4 +1,7 @@
 #include "console.h"
+#include "trace.h"
+#include "task.h"
+#include "virtio_console.h"
 
 #define UART0 0x10000000L    // QEMU virt UART base address
 #define UART0_LSR (UART0 + 5)   // Line Status Register
@@ -8,24 +11,166 @@ static inline void uart_putc(char c ){
     *(volatile unsigned char *)(UART0 + 0) = c;
 }
 
+// Backend picked at boot: a virtio-console if QEMU provides one
+// (-device virtconsole), otherwise the UART
+static enum { CONS_UART, CONS_VIRTIO } backend;
+
 void console_init() {
+    backend = virtcons_init() == 0 ? CONS_VIRTIO : CONS_UART;
+}
 
+const char *console_backend(void) {
+    return backend == CONS_VIRTIO ? "virtio" : "uart";
 }
 
-void console_putc(char c) {
+// Push out output the backend is holding back. The UART has no buffer.
+void console_flush(void) {
+    if (backend == CONS_VIRTIO) {
+        virtcons_flush();
+    }
+}
+
+// Helper: Next input byte, or -1 if none has arrived
+static int console_poll(void) {
+    if (backend == CONS_VIRTIO) {
+        return virtcons_getc();
+    }
+    if ((*(volatile unsigned char *)UART0_LSR & UART_LSR_RX_READY) == 0) {
+        return -1;
+    }
+    return *(volatile unsigned char *)(UART0 + 0);
+}
+
+// What the foreground has printed on the current line, so it can be
+// redrawn after a line of background output
+static char fg_line[CONSOLE_LINE];
+static int fg_len;
+static int fg_lost;   // Line content unknown (escape sequence or too long)
+
+static void raw_putc(char c) {
+    if (backend == CONS_VIRTIO) {
+        if (c == '\n') {
+            virtcons_putc('\r');
+        }
+        virtcons_putc(c);
+        return;
+    }
     if (c == '\n'){
         uart_putc('\r');
     }
     uart_putc(c);
 }
 
+// Set once hart 0 is reporting a fatal trap
+static volatile int panicked;
+
+// From now on hart 0 writes straight to the device and never switches
+// tasks. Other harts already do both: tasks only exist on hart 0.
+void console_panic(void) {
+    panicked = 1;
+}
+
+void console_putc(char c) {
+    if (!panicked && task_output(c)) {
+        return; // Buffered for a background job
+    }
+    raw_putc(c);
+    
+    if (c == '\n' || c == '\r') {
+        fg_len = 0;
+        fg_lost = 0;
+    } else if (c == '\b') {
+        if (fg_len > 0) fg_len--;
+    } else if (c == '\033' || fg_len == CONSOLE_LINE) {
+        fg_lost = 1;
+    } else if (!fg_lost) {
+        fg_line[fg_len++] = c;
+    }
+}
+
+// Print one line of output from background task `task` as "[task] ...".
+// The foreground's partial line (a half-typed command, say) is erased
+// first and redrawn after, so lines from concurrent jobs never mix.
+void console_emit_line(int task, const char *s, int n) {
+    if (fg_lost) {
+        raw_putc('\n');
+        fg_len = 0;
+        fg_lost = 0;
+    } else if (fg_len > 0) {
+        raw_putc('\r');
+        raw_putc('\033');
+        raw_putc('[');
+        raw_putc('K');
+    }
+    
+    raw_putc('[');
+    if (task >= 10) raw_putc('0' + task / 10);
+    raw_putc('0' + task % 10);
+    raw_putc(']');
+    raw_putc(' ');
+    for (int i = 0; i < n; i++) {
+        raw_putc(s[i]);
+    }
+    raw_putc('\n');
+    
+    for (int i = 0; i < fg_len; i++) {
+        raw_putc(fg_line[i]);
+    }
+}
+
 void console_puts(const char* s){
-    while (*s) {
-        console_putc(*s ++);
+    TRACE(TRACE_CONS, TEV_CONS_PUTS, TRACE_BEGIN, 0, 0);
+    const char *p = s;
+    while (*p) {
+        console_putc(*p ++);
+    }
+    TRACE(TRACE_CONS, TEV_CONS_PUTS, TRACE_END, p - s, 0);
+    if (!panicked) {
+        task_yield();  // Console output is a scheduling point for jobs
     }
 }
 
 int console_getc(){
-    while ((*(volatile unsigned char *)UART0_LSR & UART_LSR_RX_READY) == 0);
-    return *(volatile unsigned char *)(UART0 + 0);
+    TRACE(TRACE_CONS, TEV_CONS_GETC, TRACE_BEGIN, 0, 0);
+    // Only the foreground task reads input; everyone runs while it waits.
+    // Whatever was printed (the prompt, job output) goes out first.
+    int c;
+    while (task_current() != task_foreground() || (c = console_poll()) < 0) {
+        console_flush();
+        task_yield();
+    }
+    TRACE(TRACE_CONS, TEV_CONS_GETC, TRACE_END, c, 0);
+    return c;
+}
+
+void console_putdec(unsigned long n) {
+    char buf[24];
+    int i = 0;
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (i > 0) {
+        console_putc(buf[--i]);
+    }
+}
+
+void console_puthex(unsigned long n) {
+    console_puts("0x");
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        console_putc("0123456789abcdef"[(n >> shift) & 0xf]);
+    }
+}
+
+// Hex without prefix or leading zeros, for compact machine-readable dumps
+void console_putx(unsigned long n) {
+    char buf[16];
+    int i = 0;
+    do {
+        buf[i++] = "0123456789abcdef"[n & 0xf];
+        n >>= 4;
+    } while (n);
+    while (i > 0) {
+        console_putc(buf[--i]);
+    }
 }
@@ -1,9 +1,18 @@
 #ifndef CONSOLE_H
 #define CONSOLE_H
 
+#define CONSOLE_LINE 128   // Longest line kept for background output and redraw
+
 void console_init();
+const char *console_backend(void);   // "uart" or "virtio"
+void console_flush(void);
+void console_panic(void);   // Unbuffered, non-yielding output from here on
 void console_putc(char c);
 void console_puts(const char *s);
 int console_getc();
+void console_putdec(unsigned long n);
+void console_puthex(unsigned long n);
+void console_putx(unsigned long n);
+void console_emit_line(int task, const char *s, int n);
 
 #endif
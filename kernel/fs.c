@@ -1,118 +1,760 @@
 #include "fs.h"
 #include "string.h"
+#include "trace.h"
+#include "lz.h"
+#include "perf.h"
+#include "spinlock.h"
 
-static inode_t inodes[MAX_FILES];
-static int current_dir = 0;  // Current working directory index
+// Filesystem state lives in the .persist section, which the boot path
+// never clears. A warm reboot seals it with a checksum; the next fs_init()
+// validates the seal and reattaches instead of starting over.
+#define PERSIST __attribute__((section(".persist")))
 
-// Helper: Find a free inode
-static int alloc_inode(void) {
+#define FS_PERSIST_MAGIC   0x5453495352455046UL  // "FPERSIST"
+#define FS_PERSIST_VERSION 4
+
+struct persist_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t layout;    // state size: catches kernels with another layout
+    uint64_t checksum;
+};
+
+static inode_t inodes[MAX_FILES] PERSIST;
+static char blocks[NBLOCKS][BLOCK_SIZE] PERSIST;
+static uint16_t block_ref[NBLOCKS] PERSIST;  // References from inodes; 0 = free
+static struct persist_header persist_hdr PERSIST;
+
+#define PERSIST_LAYOUT (sizeof(inodes) + sizeof(blocks) + sizeof(block_ref))
+
+static int block_hint;  // Where alloc_block() starts looking
+static int blocks_free; // Blocks with block_ref 0
+static uint8_t default_compress = FS_COMPRESS_OFF;  // Mode for new files
+
+// Compression counters for fs_get_stats()
+static uint64_t z_bytes, z_cycles, unz_bytes, unz_cycles;
+
+// Synchronization state, one per inode; it is not persistent, so every
+// boot starts unlocked. Lock order: directory locks parent before child,
+// then itable_lock or inode locks, then repack_lock, then block_lock.
+// Only fs_dedup() holds more than one inode lock, taking them in index
+// order.
+struct inode_sync {
+    struct spinlock lock;     // File data: size, blocks, packing
+    struct spinlock dirlock;  // Held to create or delete entries in a directory
+    volatile uint32_t seq;    // Odd while an entry of this directory changes
+    uint32_t gen;             // Bumped on every allocation of the inode
+    uint32_t pins;            // Contexts whose cwd is this directory
+};
+
+static struct inode_sync isync[MAX_FILES];
+static struct spinlock itable_lock;  // Claiming free inodes
+static struct spinlock block_lock;   // block_ref[], block_hint, blocks_free
+static struct spinlock repack_lock;  // repack_buf[]
+
+// Whole-file copy for rewrites, kept off the small task stacks
+static char repack_buf[MAX_FILE_SIZE];
+
+// Helper: Allocate an inode and publish it as an entry of parent. Free
+// inodes have parent_idx -1, so lock-free lookups never match one while
+// it is filled in. The caller holds parent's dirlock.
+static int alloc_inode(int parent, const char *name, file_type_t type) {
+    int idx = -1;
+
+    acquire(&itable_lock);
     for (int i = 0; i < MAX_FILES; i++) {
         if (!inodes[i].used) {
-            inodes[i].used = 1;
-            inodes[i].size = 0;
-            inodes[i].parent_idx = -1;
-            return i;
+            idx = i;
+            break;
         }
     }
-    return -1; // No free inodes
+    if (idx >= 0) {
+        inode_t *ino = &inodes[idx];
+        strncpy(ino->name, name, MAX_FILENAME - 1);
+        ino->name[MAX_FILENAME - 1] = '\0';
+        ino->type = type;
+        ino->size = 0;
+        ino->stored = 0;
+        ino->tail = 0;
+        ino->packed = 0;
+        ino->compress = default_compress;
+        isync[idx].gen++;
+
+        seq_write_begin(&isync[parent].seq);
+        ino->parent_idx = parent;
+        ino->used = 1;
+        seq_write_end(&isync[parent].seq);
+    }
+    release(&itable_lock);
+    return idx; // -1: no free inodes
 }
 
-// Helper: Parse path and find file/directory
-int fs_find(const char *path) {
-    // Handle absolute path (starts with /)
-    int search_dir = (path[0] == '/') ? 0 : current_dir;
-    
-    // Handle root directory
-    if (strcmp(path, "/") == 0) {
+// Helper: Allocate a zeroed data block from the pool. Zeroing keeps
+// stale bytes out of partially used blocks, which also helps fs_dedup().
+// The caller holds block_lock.
+static int alloc_block(void) {
+    for (int n = 0; n < NBLOCKS; n++) {
+        int b = (block_hint + n) % NBLOCKS;
+        if (block_ref[b] == 0) {
+            block_ref[b] = 1;
+            blocks_free--;
+            block_hint = (b + 1) % NBLOCKS;
+            for (int k = 0; k < BLOCK_SIZE; k++) {
+                blocks[b][k] = 0;
+            }
+            return b;
+        }
+    }
+    return -1; // Pool exhausted
+}
+
+// Helper: Make the blocks covering stored bytes [off, off + n) present and
+// private to this inode. Blocks shared with other files (after cp or
+// dedup) are copied first: this is the copy-on-write point.
+static int prepare_write(inode_t *ino, uint32_t off, uint32_t n) {
+    if (n == 0) {
         return 0;
     }
+    uint32_t last = (off + n - 1) / BLOCK_SIZE;
+    if (last >= MAX_FILE_BLOCKS) {
+        return -1;
+    }
+    int ret = 0;
+    acquire(&block_lock);
+    for (uint32_t i = off / BLOCK_SIZE; i <= last; i++) {
+        int old = ino->blocks[i];
+        if (old >= 0 && block_ref[old] == 1) {
+            continue;
+        }
+        int b = alloc_block();
+        if (b < 0) {
+            ret = -1; // Pool exhausted
+            break;
+        }
+        if (old >= 0) {
+            for (int k = 0; k < BLOCK_SIZE; k++) {
+                blocks[b][k] = blocks[old][k];
+            }
+            block_ref[old]--;
+        }
+        ino->blocks[i] = b;
+    }
+    release(&block_lock);
+    return ret;
+}
+
+// Helper: Drop references to shared blocks without copying them, for
+// callers about to overwrite the whole file
+static void detach_shared(inode_t *ino) {
+    acquire(&block_lock);
+    for (int i = 0; i < MAX_FILE_BLOCKS; i++) {
+        int b = ino->blocks[i];
+        if (b >= 0 && block_ref[b] > 1) {
+            block_ref[b]--;
+            ino->blocks[i] = -1;
+        }
+    }
+    release(&block_lock);
+}
+
+// Helper: Release blocks beyond the first `bytes` stored bytes
+static void truncate_blocks(inode_t *ino, uint32_t bytes) {
+    acquire(&block_lock);
+    for (uint32_t i = (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE; i < MAX_FILE_BLOCKS; i++) {
+        if (ino->blocks[i] >= 0) {
+            if (--block_ref[ino->blocks[i]] == 0) {
+                blocks_free++;
+            }
+            ino->blocks[i] = -1;
+        }
+    }
+    release(&block_lock);
+    ino->stored = bytes;
+}
+
+// Helper: Copy n stored bytes starting at off out of the file's blocks
+static void stream_read(const inode_t *ino, uint32_t off, void *dst, uint32_t n) {
+    char *d = dst;
+    while (n > 0) {
+        uint32_t o = off % BLOCK_SIZE;
+        uint32_t k = BLOCK_SIZE - o < n ? BLOCK_SIZE - o : n;
+        const char *src = blocks[ino->blocks[off / BLOCK_SIZE]] + o;
+        for (uint32_t i = 0; i < k; i++) {
+            d[i] = src[i];
+        }
+        d += k;
+        off += k;
+        n -= k;
+    }
+}
+
+// Helper: Copy n bytes into the file's blocks at stored offset off
+// (the range must have gone through prepare_write)
+static void stream_write(inode_t *ino, uint32_t off, const void *src, uint32_t n) {
+    const char *s = src;
+    while (n > 0) {
+        uint32_t o = off % BLOCK_SIZE;
+        uint32_t k = BLOCK_SIZE - o < n ? BLOCK_SIZE - o : n;
+        char *dst = blocks[ino->blocks[off / BLOCK_SIZE]] + o;
+        for (uint32_t i = 0; i < k; i++) {
+            dst[i] = s[i];
+        }
+        s += k;
+        off += k;
+        n -= k;
+    }
+}
+
+// Packed files hold a stream of segments, each a 4-byte header
+// {raw length, stored length} followed by the stored bytes. A segment
+// is compressed when stored < raw. Appends grow the last segment while
+// it is uncompressed and shorter than FS_SEG_MAX, and compress it once
+// it fills, so earlier segments are never recompressed.
+#define FS_SEG_MAX 256
+#define SEG_HDR 4
+
+static void seg_get(const inode_t *ino, uint32_t off, uint32_t *raw, uint32_t *stored) {
+    uint8_t h[SEG_HDR];
+    stream_read(ino, off, h, SEG_HDR);
+    *raw = h[0] | (h[1] << 8);
+    *stored = h[2] | (h[3] << 8);
+}
+
+static void seg_put(inode_t *ino, uint32_t off, uint32_t raw, uint32_t stored) {
+    uint8_t h[SEG_HDR] = { raw & 0xff, raw >> 8, stored & 0xff, stored >> 8 };
+    stream_write(ino, off, h, SEG_HDR);
+}
+
+// Helper: Compress, counting bytes and cycles for fs_get_stats()
+static int zcompress(const void *src, uint32_t n, uint8_t *dst, uint32_t cap) {
+    uint64_t t = perf_cycles();
+    int len = lz_compress(src, n, dst, cap);
+    __atomic_fetch_add(&z_cycles, perf_cycles() - t, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&z_bytes, n, __ATOMIC_RELAXED);
+    return len;
+}
+
+static int zdecompress(const uint8_t *src, uint32_t n, void *dst, uint32_t cap) {
+    uint64_t t = perf_cycles();
+    int len = lz_decompress(src, n, dst, cap);
+    __atomic_fetch_add(&unz_cycles, perf_cycles() - t, __ATOMIC_RELAXED);
+    if (len > 0) __atomic_fetch_add(&unz_bytes, len, __ATOMIC_RELAXED);
+    return len;
+}
+
+// Helper: Compress the full uncompressed tail segment in place
+static void seal_tail(inode_t *ino) {
+    uint8_t raw[FS_SEG_MAX];
+    uint8_t z[FS_SEG_MAX];
+    uint32_t rlen, slen;
+
+    seg_get(ino, ino->tail, &rlen, &slen);
+    stream_read(ino, ino->tail + SEG_HDR, raw, rlen);
+    int zlen = zcompress(raw, rlen, z, rlen - 1);
+    if (zlen < 0 || prepare_write(ino, ino->tail, SEG_HDR + zlen) < 0) {
+        return; // Incompressible: leave it stored raw
+    }
+    seg_put(ino, ino->tail, rlen, zlen);
+    stream_write(ino, ino->tail + SEG_HDR, z, zlen);
+    truncate_blocks(ino, ino->tail + SEG_HDR + zlen);
+}
+
+// Helper: Append to a packed file; returns bytes appended or -1
+static int append_packed(inode_t *ino, const char *data, uint32_t n) {
+    uint8_t z[FS_SEG_MAX];
+    uint32_t done = 0;
+
+    while (done < n) {
+        uint32_t rlen, slen;
+
+        // Grow an open (uncompressed, not yet full) tail segment
+        if (ino->stored > 0) {
+            seg_get(ino, ino->tail, &rlen, &slen);
+            if (rlen == slen && rlen < FS_SEG_MAX) {
+                uint32_t k = n - done < FS_SEG_MAX - rlen ? n - done : FS_SEG_MAX - rlen;
+                if (prepare_write(ino, ino->tail, ino->stored + k - ino->tail) < 0) {
+                    return -1;
+                }
+                stream_write(ino, ino->stored, data + done, k);
+                ino->stored += k;
+                seg_put(ino, ino->tail, rlen + k, rlen + k);
+                ino->size += k;
+                done += k;
+                if (rlen + k == FS_SEG_MAX) {
+                    seal_tail(ino);
+                }
+                continue;
+            }
+        }
+
+        // Start a new segment; a full one is compressed straight from data
+        uint32_t k = n - done < FS_SEG_MAX ? n - done : FS_SEG_MAX;
+        int zlen = (k == FS_SEG_MAX) ? zcompress(data + done, k, z, k - 1) : -1;
+        uint32_t slen_new = zlen >= 0 ? (uint32_t)zlen : k;
+        if (prepare_write(ino, ino->stored, SEG_HDR + slen_new) < 0) {
+            return -1;
+        }
+        ino->tail = ino->stored;
+        seg_put(ino, ino->tail, k, slen_new);
+        stream_write(ino, ino->tail + SEG_HDR, zlen >= 0 ? (const void *)z : data + done, slen_new);
+        ino->stored += SEG_HDR + slen_new;
+        ino->size += k;
+        done += k;
+    }
+    return done;
+}
+
+// Helper: Read up to size bytes of a file into buf; returns bytes or -1
+static int read_data(const inode_t *ino, char *buf, uint32_t size) {
+    if (size > ino->size) {
+        size = ino->size;
+    }
+    if (!ino->packed) {
+        stream_read(ino, 0, buf, size);
+        return size;
+    }
+
+    uint8_t z[FS_SEG_MAX];
+    uint8_t raw[FS_SEG_MAX];
+    uint32_t off = 0, out = 0;
+
+    while (out < size) {
+        uint32_t rlen, slen;
+        if (off + SEG_HDR > ino->stored) {
+            return -1;
+        }
+        seg_get(ino, off, &rlen, &slen);
+        if (rlen > FS_SEG_MAX || slen > rlen || off + SEG_HDR + slen > ino->stored) {
+            return -1;
+        }
+
+        uint32_t k = size - out < rlen ? size - out : rlen;
+        if (slen == rlen) {
+            stream_read(ino, off + SEG_HDR, buf + out, k);
+        } else {
+            stream_read(ino, off + SEG_HDR, z, slen);
+            // Decompress straight into buf when the whole segment is wanted
+            char *dst = (k == rlen) ? buf + out : (char *)raw;
+            if (zdecompress(z, slen, dst, rlen) != (int)rlen) {
+                return -1;
+            }
+            if (dst != buf + out) {
+                for (uint32_t i = 0; i < k; i++) buf[out + i] = raw[i];
+            }
+        }
+        out += k;
+        off += SEG_HDR + slen;
+    }
+    return out;
+}
+
+// Helper: Whether inode a is b or one of b's ancestors
+static int is_ancestor(int a, int b) {
+    while (a != b) {
+        if (b == 0) {
+            return 0;
+        }
+        b = inodes[b].parent_idx;
+    }
+    return 1;
+}
+
+// Helper: Count the inodes in the subtree rooted at idx
+static int subtree_size(int idx) {
+    int n = 1;
+    if (inodes[idx].type == TYPE_DIR) {
+        for (int i = 0; i < MAX_FILES; i++) {
+            // i != idx: the root is its own parent
+            if (inodes[i].used && inodes[i].parent_idx == idx && i != idx) {
+                n += subtree_size(i);
+            }
+        }
+    }
+    return n;
+}
+
+// Helper: Copy inode src (and, for a directory, everything below it) into
+// parent under name. Data blocks are shared by reference, not copied.
+// The caller holds parent's dirlock and has checked that enough inodes
+// are free; if concurrent creates use them up first, the copy is left
+// partial and -1 returned.
+static int copy_inode(int src, int parent, const char *name) {
+    int idx = alloc_inode(parent, name, inodes[src].type);
+    if (idx < 0) {
+        return -1; // No space
+    }
+    inode_t *d = &inodes[idx];
+    inode_t s;
+
+    // Snapshot the source, taking block references while it is locked
+    acquire(&isync[src].lock);
+    s = inodes[src];
+    acquire(&block_lock);
+    for (int b = 0; b < MAX_FILE_BLOCKS; b++) {
+        if (s.blocks[b] >= 0) {
+            block_ref[s.blocks[b]]++;
+        }
+    }
+    release(&block_lock);
+    release(&isync[src].lock);
+
+    // The copy is already visible: replace whatever was written meanwhile
+    acquire(&isync[idx].lock);
+    truncate_blocks(d, 0);
+    d->size = s.size;
+    d->stored = s.stored;
+    d->tail = s.tail;
+    d->packed = s.packed;
+    d->compress = s.compress;
+    for (int b = 0; b < MAX_FILE_BLOCKS; b++) {
+        d->blocks[b] = s.blocks[b];
+    }
+    release(&isync[idx].lock);
+
+    int ret = idx;
+    if (s.type == TYPE_DIR) {
+        acquire(&isync[idx].dirlock);
+        for (int i = 0; i < MAX_FILES; i++) {
+            if (inodes[i].used && inodes[i].parent_idx == src && i != src &&
+                copy_inode(i, idx, inodes[i].name) < 0) {
+                ret = -1;
+                break;
+            }
+        }
+        release(&isync[idx].dirlock);
+    }
+    return ret;
+}
+
+// Helper: Whether a file of this size should be stored compressed
+static int want_packed(const inode_t *ino, uint32_t size) {
+    return ino->compress == FS_COMPRESS_ON ||
+           (ino->compress == FS_COMPRESS_AUTO && size >= FS_COMPRESS_THRESHOLD);
+}
+
+// Helper: Whether the pool can hold size bytes for this file, counting
+// its private blocks, which a rewrite reuses or frees. NBLOCKS covers
+// every file at its largest, so this only fails if that ever changes;
+// it keeps a failed write from destroying the old contents.
+static int have_room(const inode_t *ino, uint32_t size, int packed) {
+    uint32_t stored = size;
+    if (packed) {
+        stored += SEG_HDR * ((size + FS_SEG_MAX - 1) / FS_SEG_MAX);
+    }
+    int need = (stored + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    acquire(&block_lock);
+    int avail = blocks_free;
+    for (int i = 0; i < MAX_FILE_BLOCKS; i++) {
+        avail += ino->blocks[i] >= 0 && block_ref[ino->blocks[i]] == 1;
+    }
+    release(&block_lock);
+    return avail >= need;
+}
+
+// Helper: Replace a file's contents; returns bytes stored or -1
+static int store_data(inode_t *ino, const char *data, uint32_t size) {
+    if (!have_room(ino, size, want_packed(ino, size))) {
+        return -1; // No space; the old contents are untouched
+    }
+    ino->size = 0;
+    ino->tail = 0;
+    ino->packed = want_packed(ino, size);
+
+    if (ino->packed) {
+        truncate_blocks(ino, 0);
+        return append_packed(ino, data, size);
+    }
+
+    // Overwrite in place, keeping the private blocks that are still needed
+    detach_shared(ino);
+    if (prepare_write(ino, 0, size) < 0) {
+        truncate_blocks(ino, 0);
+        return -1; // No space
+    }
+    truncate_blocks(ino, size);
+    stream_write(ino, 0, data, size);
+    ino->size = size;
+    return size;
+}
+
+// Helper: Find name among dir's entries without taking any lock. Creates
+// and deletes in dir make its sequence counter odd while they run, so a
+// scan that overlapped one is retried.
+static int lookup(int dir, const char *name, uint32_t *gen) {
+    volatile uint32_t *seq = &isync[dir].seq;
+    uint32_t s;
+    int idx;
+
+    do {
+        s = seq_read_begin(seq);
+        idx = -1;
+        for (int i = 0; i < MAX_FILES; i++) {
+            if (inodes[i].used &&
+                inodes[i].parent_idx == dir &&
+                strcmp(inodes[i].name, name) == 0) {
+                idx = i;
+                *gen = isync[i].gen;
+                break;
+            }
+        }
+    } while (seq_read_retry(seq, s));
+    return idx;
+}
+
+// Helper: Parse path and find file/directory. *gen receives the inode's
+// generation, which callers that lock it later use to detect reuse.
+static int find_path(const char *path, uint32_t *gen) {
+    // Handle absolute path (starts with /)
+    int search_dir = (path[0] == '/') ? 0 : fs_context()->cwd;
+    int idx;
     
     // Skip leading slash
     if (path[0] == '/') {
         path++;
     }
     
-    // Handle empty path or "."
     if (path[0] == '\0' || strcmp(path, ".") == 0) {
-        return search_dir;
+        // Root directory, empty path or "."
+        idx = search_dir;
+    } else if (strcmp(path, "..") == 0) {
+        // Parent directory; root is its own parent
+        idx = inodes[search_dir].parent_idx;
+    } else {
+        // Search for file/directory in search_dir
+        return lookup(search_dir, path, gen);
     }
-    
-    // Handle parent directory ".."
-    if (strcmp(path, "..") == 0) {
-        if (search_dir == 0) return 0; // Already at root
-        return inodes[search_dir].parent_idx;
+    *gen = isync[idx].gen;
+    return idx;
+}
+
+// Find file/directory by path
+int fs_find(const char *path) {
+    uint32_t gen;
+    TRACE(TRACE_FS, TEV_FS_FIND, TRACE_BEGIN, 0, trace_tag(path));
+    int idx = find_path(path, &gen);
+    TRACE(TRACE_FS, TEV_FS_FIND, TRACE_END, idx, 0);
+    return idx;
+}
+
+// Helper: Find a file and lock its inode. NULL if it is missing, not a
+// file, or was deleted (and maybe reused) between lookup and lock.
+static inode_t *lock_file(const char *path) {
+    uint32_t gen;
+    int idx = find_path(path, &gen);
+    if (idx < 0) {
+        return NULL; // File not found
     }
     
-    // Search for file/directory in search_dir
+    acquire(&isync[idx].lock);
+    if (!inodes[idx].used || isync[idx].gen != gen || inodes[idx].type != TYPE_FILE) {
+        release(&isync[idx].lock);
+        return NULL; // Gone, or not a file
+    }
+    return &inodes[idx];
+}
+
+static void unlock_file(inode_t *ino) {
+    release(&isync[ino - inodes].lock);
+}
+
+// Helper: 64-bit multiplicative hash over a word-aligned region
+static uint64_t persist_sum(uint64_t h, const void *p, unsigned long len) {
+    const uint64_t *w = (const uint64_t *)p;
+    const unsigned char *b;
+
+    for (; len >= 8; len -= 8) {
+        h = (h ^ *w++) * 0x100000001b3UL;
+    }
+    for (b = (const unsigned char *)w; len > 0; len--) {
+        h = (h ^ *b++) * 0x100000001b3UL;
+    }
+    return h;
+}
+
+static uint64_t persist_checksum(void) {
+    uint64_t h = 0xcbf29ce484222325UL;
+    h = persist_sum(h, inodes, sizeof(inodes));
+    h = persist_sum(h, blocks, sizeof(blocks));
+    h = persist_sum(h, block_ref, sizeof(block_ref));
+    return h;
+}
+
+// Check the structural invariants: a root directory, parent chains that
+// reach it through directories, unique names within a directory, free
+// inodes unlinked and without blocks, and block refcounts that match the
+// references. Returns 0 if they hold, -1 if not. The filesystem must be
+// quiescent.
+int fs_check(void) {
+    if (!inodes[0].used || inodes[0].type != TYPE_DIR || inodes[0].parent_idx != 0) {
+        return -1;
+    }
     for (int i = 0; i < MAX_FILES; i++) {
-        if (inodes[i].used && 
-            inodes[i].parent_idx == search_dir &&
-            strcmp(inodes[i].name, path) == 0) {
-            return i;
+        for (int b = 0; b < MAX_FILE_BLOCKS; b++) {
+            int blk = inodes[i].blocks[b];
+            if (blk < -1 || blk >= NBLOCKS || (!inodes[i].used && blk != -1)) {
+                return -1;
+            }
+        }
+        if (!inodes[i].used) {
+            if (inodes[i].parent_idx != -1) {
+                return -1;
+            }
+            continue;
+        }
+        if (inodes[i].size > MAX_FILE_SIZE ||
+            inodes[i].stored > MAX_FILE_BLOCKS * BLOCK_SIZE) {
+            return -1;
+        }
+        
+        // Walk up to the root; a cycle runs out of steps
+        int p = i, steps = 0;
+        while (p != 0 && steps++ < MAX_FILES) {
+            p = inodes[p].parent_idx;
+            if (p < 0 || p >= MAX_FILES || !inodes[p].used || inodes[p].type != TYPE_DIR) {
+                return -1;
+            }
+        }
+        if (p != 0) {
+            return -1;
+        }
+        
+        for (int j = i + 1; j < MAX_FILES; j++) {
+            if (inodes[j].used && inodes[j].parent_idx == inodes[i].parent_idx &&
+                strcmp(inodes[j].name, inodes[i].name) == 0) {
+                return -1; // Duplicate name
+            }
         }
     }
     
-    return -1; // Not found
+    // Every block's refcount must match the references to it
+    for (int b = 0; b < NBLOCKS; b++) {
+        uint32_t refs = 0;
+        for (int i = 0; i < MAX_FILES; i++) {
+            if (!inodes[i].used) continue;
+            for (int k = 0; k < MAX_FILE_BLOCKS; k++) {
+                refs += inodes[i].blocks[k] == b;
+            }
+        }
+        if (refs != block_ref[b]) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Helper: Check that the preserved state is sealed and self-consistent
+static int persist_valid(void) {
+    if (persist_hdr.magic != FS_PERSIST_MAGIC ||
+        persist_hdr.version != FS_PERSIST_VERSION ||
+        persist_hdr.layout != PERSIST_LAYOUT ||
+        persist_hdr.checksum != persist_checksum()) {
+        return 0;
+    }
+    return fs_check() == 0;
 }
 
-// Initialize filesystem
-void fs_init(void) {
-    // Clear all inodes
+// Seal the filesystem so the next boot can reattach to it
+void fs_persist_seal(void) {
+    persist_hdr.version = FS_PERSIST_VERSION;
+    persist_hdr.layout = PERSIST_LAYOUT;
+    persist_hdr.checksum = persist_checksum();
+    persist_hdr.magic = FS_PERSIST_MAGIC;
+}
+
+// Drop the seal: the next boot starts with a fresh filesystem
+void fs_persist_discard(void) {
+    persist_hdr.magic = 0;
+}
+
+// Initialize filesystem. Runs before any other context uses it; every
+// context's working directory starts at the root.
+// Returns 1 if the state preserved across a warm reboot was reattached,
+// 0 if a fresh filesystem was created.
+int fs_init(void) {
     for (int i = 0; i < MAX_FILES; i++) {
-        inodes[i].used = 0;
+        isync[i] = (struct inode_sync){ 0 };
     }
+    initlock(&itable_lock);
+    initlock(&block_lock);
+    initlock(&repack_lock);
+    fs_context()->cwd = 0;
     
-    // Create root directory
-    int root_idx = alloc_inode();
-    strcpy(inodes[root_idx].name, "/");
-    inodes[root_idx].type = TYPE_DIR;
-    inodes[root_idx].parent_idx = 0; // Root is its own parent
-    
-    current_dir = 0;
+    if (persist_valid()) {
+        // The live state diverges from the seal from now on
+        fs_persist_discard();
+        blocks_free = 0;
+        for (int b = 0; b < NBLOCKS; b++) {
+            blocks_free += block_ref[b] == 0;
+        }
+        return 1;
+    }
+    fs_persist_discard();
+
+    // .persist is not cleared at boot, so start from empty tables
+    for (int i = 0; i < MAX_FILES; i++) {
+        inodes[i].used = 0;
+        inodes[i].parent_idx = -1;
+        for (int b = 0; b < MAX_FILE_BLOCKS; b++) {
+            inodes[i].blocks[b] = -1;
+        }
+    }
+    for (int b = 0; b < NBLOCKS; b++) {
+        block_ref[b] = 0;
+    }
+    blocks_free = NBLOCKS;
+
+    // Create root directory; it is its own parent
+    alloc_inode(0, "/", TYPE_DIR);
     
     // Create some initial files
+    static const char welcome[] =
+        "Welcome to Tiny RISC-V Kernel!\nTry 'ls', 'cat', 'touch', 'mkdir', 'cd', and 'sh' commands.\n";
+    static const char hello[] =
+        "echo Hello from shell script!\necho This is a simple script\n";
+    static const char test[] = "This is a test file.\n";
+
     fs_create("welcome.txt", TYPE_FILE);
-    fs_write("welcome.txt", "Welcome to Tiny RISC-V Kernel!\nTry 'ls', 'cat', 'touch', 'mkdir', 'cd', and 'sh' commands.\n", 95);
+    fs_write("welcome.txt", welcome, sizeof(welcome) - 1);
     
     fs_create("hello.sh", TYPE_FILE);
-    fs_write("hello.sh", "echo Hello from shell script!\necho This is a simple script\n", 60);
+    fs_write("hello.sh", hello, sizeof(hello) - 1);
     
     fs_create("test.txt", TYPE_FILE);
-    fs_write("test.txt", "This is a test file.\n", 21);
+    fs_write("test.txt", test, sizeof(test) - 1);
+
+    return 0;
 }
 
-// Create a new file or directory
-int fs_create(const char *path, file_type_t type) {
-    // Check if already exists
-    if (fs_find(path) >= 0) {
-        return -1; // Already exists
-    }
+// Helper: Create a new file or directory
+static int create_path(const char *path, file_type_t type) {
+    int dir = fs_context()->cwd;
+    int idx = -1;
     
-    // Allocate new inode
-    int idx = alloc_inode();
-    if (idx < 0) {
-        return -1; // No space
+    // The existence check and the insert happen under the directory lock,
+    // so of two racing creates of one name only one succeeds
+    acquire(&isync[dir].dirlock);
+    if (fs_find(path) < 0) {
+        idx = alloc_inode(dir, path, type); // -1 if no space
     }
-    
-    // Set up inode
-    strncpy(inodes[idx].name, path, MAX_FILENAME - 1);
-    inodes[idx].name[MAX_FILENAME - 1] = '\0';
-    inodes[idx].type = type;
-    inodes[idx].size = 0;
-    inodes[idx].parent_idx = current_dir;
+    release(&isync[dir].dirlock);
     
     return idx;
 }
 
-// Write data to a file
-int fs_write(const char *path, const char *data, uint32_t size) {
-    int idx = fs_find(path);
-    if (idx < 0) {
-        return -1; // File not found
-    }
-    
-    if (inodes[idx].type != TYPE_FILE) {
-        return -1; // Not a file
+// Create a new file or directory
+int fs_create(const char *path, file_type_t type) {
+    TRACE(TRACE_FS, TEV_FS_CREATE, TRACE_BEGIN, type, trace_tag(path));
+    int idx = create_path(path, type);
+    TRACE(TRACE_FS, TEV_FS_CREATE, TRACE_END, idx, 0);
+    return idx;
+}
+
+// Helper: Write data to a file
+static int write_file(const char *path, const char *data, uint32_t size) {
+    inode_t *ino = lock_file(path);
+    if (!ino) {
+        return -1; // Not found or not a file
     }
     
     // Limit size to max file size
@@ -120,64 +762,85 @@ int fs_write(const char *path, const char *data, uint32_t size) {
         size = MAX_FILE_SIZE;
     }
     
-    // Copy data
-    for (uint32_t i = 0; i < size; i++) {
-        inodes[idx].data[i] = data[i];
-    }
-    inodes[idx].size = size;
-    
-    return size;
+    int ret = store_data(ino, data, size);
+    unlock_file(ino);
+    return ret;
 }
 
-// Append data to a file
-int fs_append(const char *path, const char *data, uint32_t size) {
-    int idx = fs_find(path);
-    if (idx < 0) {
-        return -1; // File not found
-    }
-    
-    if (inodes[idx].type != TYPE_FILE) {
-        return -1; // Not a file
-    }
-    
-    uint32_t current_size = inodes[idx].size;
+// Write data to a file
+int fs_write(const char *path, const char *data, uint32_t size) {
+    TRACE(TRACE_FS, TEV_FS_WRITE, TRACE_BEGIN, size, trace_tag(path));
+    int ret = write_file(path, data, size);
+    TRACE(TRACE_FS, TEV_FS_WRITE, TRACE_END, ret, 0);
+    return ret;
+}
+
+// Helper: Append to a locked file
+static int append_locked(inode_t *ino, const char *data, uint32_t size) {
+    uint32_t current_size = ino->size;
     uint32_t available = MAX_FILE_SIZE - current_size;
     
     if (size > available) {
         size = available;
     }
     
-    // Append data
-    for (uint32_t i = 0; i < size; i++) {
-        inodes[idx].data[current_size + i] = data[i];
+    if (ino->packed) {
+        return append_packed(ino, data, size);
     }
-    inodes[idx].size = current_size + size;
     
-    return size;
-}
-
-// Read data from a file
-int fs_read(const char *path, char *buf, uint32_t size) {
-    int idx = fs_find(path);
-    if (idx < 0) {
-        return -1; // File not found
+    if (want_packed(ino, current_size + size)) {
+        // Crossing the auto threshold: pack the whole file once
+        acquire(&repack_lock);
+        read_data(ino, repack_buf, current_size);
+        for (uint32_t i = 0; i < size; i++) {
+            repack_buf[current_size + i] = data[i];
+        }
+        int ret = store_data(ino, repack_buf, current_size + size) < 0 ? -1 : (int)size;
+        release(&repack_lock);
+        return ret;
     }
     
-    if (inodes[idx].type != TYPE_FILE) {
-        return -1; // Not a file
+    // Append data
+    if (prepare_write(ino, current_size, size) < 0) {
+        return -1; // No space
     }
+    stream_write(ino, current_size, data, size);
+    ino->stored = current_size + size;
+    ino->size = current_size + size;
     
-    // Limit size to actual file size
-    if (size > inodes[idx].size) {
-        size = inodes[idx].size;
+    return size;
+}
+
+// Helper: Append data to a file
+static int append_file(const char *path, const char *data, uint32_t size) {
+    inode_t *ino = lock_file(path);
+    if (!ino) {
+        return -1; // Not found or not a file
     }
     
-    // Copy data
-    for (uint32_t i = 0; i < size; i++) {
-        buf[i] = inodes[idx].data[i];
+    int ret = append_locked(ino, data, size);
+    unlock_file(ino);
+    return ret;
+}
+
+// Append data to a file
+int fs_append(const char *path, const char *data, uint32_t size) {
+    TRACE(TRACE_FS, TEV_FS_APPEND, TRACE_BEGIN, size, trace_tag(path));
+    int ret = append_file(path, data, size);
+    TRACE(TRACE_FS, TEV_FS_APPEND, TRACE_END, ret, 0);
+    return ret;
+}
+
+// Read data from a file
+int fs_read(const char *path, char *buf, uint32_t size) {
+    inode_t *ino = lock_file(path);
+    if (!ino) {
+        return -1; // Not found or not a file
     }
     
-    return size;
+    int ret = read_data(ino, buf, size);
+    unlock_file(ino);
+    return ret;
 }
 
 // List directory contents
@@ -190,27 +853,66 @@ int fs_list(int dir_idx, void (*callback)(const char *name, file_type_t type, ui
         return -1; // Not a directory
     }
     
-    int count = 0;
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (inodes[i].used && inodes[i].parent_idx == dir_idx) {
-            callback(inodes[i].name, inodes[i].type, inodes[i].size);
-            count++;
+    // Snapshot the entries like lookup() does, then report them with no
+    // lock held (callbacks may print and take a while)
+    struct {
+        char name[MAX_FILENAME];
+        file_type_t type;
+        uint32_t size;
+    } ent[MAX_FILES];
+    volatile uint32_t *seq = &isync[dir_idx].seq;
+    uint32_t s;
+    int count;
+    
+    do {
+        s = seq_read_begin(seq);
+        count = 0;
+        for (int i = 0; i < MAX_FILES; i++) {
+            if (inodes[i].used && inodes[i].parent_idx == dir_idx) {
+                strcpy(ent[count].name, inodes[i].name);
+                ent[count].type = inodes[i].type;
+                ent[count].size = inodes[i].size;
+                count++;
+            }
         }
-    }
+    } while (seq_read_retry(seq, s));
     
+    for (int i = 0; i < count; i++) {
+        callback(ent[i].name, ent[i].type, ent[i].size);
+    }
     return count;
 }
 
 // Get current working directory
 int fs_get_cwd(void) {
-    return current_dir;
+    return fs_context()->cwd;
 }
 
-// Set current working directory
+// Set current working directory. A directory is pinned while it is some
+// context's cwd, so it cannot be deleted from under it (the root, which
+// cannot be deleted anyway, is not counted).
 void fs_set_cwd(int idx) {
-    if (idx >= 0 && idx < MAX_FILES && inodes[idx].used && inodes[idx].type == TYPE_DIR) {
-        current_dir = idx;
+    fs_context_t *ctx = fs_context();
+    if (idx < 0 || idx >= MAX_FILES || idx == ctx->cwd) {
+        return;
     }
+    
+    acquire(&isync[idx].dirlock);
+    int ok = inodes[idx].used && inodes[idx].type == TYPE_DIR;
+    if (ok && idx != 0) {
+        isync[idx].pins++;
+    }
+    release(&isync[idx].dirlock);
+    if (!ok) {
+        return;
+    }
+    
+    if (ctx->cwd != 0) {
+        acquire(&isync[ctx->cwd].dirlock);
+        isync[ctx->cwd].pins--;
+        release(&isync[ctx->cwd].dirlock);
+    }
+    ctx->cwd = idx;
 }
 
 // Get file/directory name
@@ -237,30 +939,220 @@ uint32_t fs_get_size(int idx) {
     return 0;
 }
 
-// Get file data
-const char* fs_get_data(int idx) {
-    if (idx >= 0 && idx < MAX_FILES && inodes[idx].used) {
-        return inodes[idx].data;
+// Helper: Copy src to dst in dir, whose dirlock the caller holds
+static int copy_path(const char *src, const char *dst, int recursive, int dir) {
+    int idx = fs_find(src);
+    if (idx < 0 || fs_find(dst) >= 0) {
+        return -1; // Source missing or destination exists
     }
-    return NULL;
+    
+    if (inodes[idx].type == TYPE_DIR) {
+        if (!recursive || is_ancestor(idx, dir)) {
+            return -1; // Would copy a directory into itself
+        }
+    }
+    
+    // All or nothing: make sure the whole tree fits
+    int free_inodes = 0;
+    for (int i = 0; i < MAX_FILES; i++) {
+        free_inodes += !inodes[i].used;
+    }
+    if (subtree_size(idx) > free_inodes) {
+        return -1; // No space
+    }
+    
+    return copy_inode(idx, dir, dst);
 }
 
-// Delete a file or empty directory
-int fs_delete(const char *path) {
-    int idx = fs_find(path);
-    if (idx < 0 || idx == 0) {
-        return -1; // Not found or trying to delete root
+// Copy src to dst in the current directory; directories need recursive.
+// Copies share data blocks with the source until either side is written.
+int fs_copy(const char *src, const char *dst, int recursive) {
+    int dir = fs_context()->cwd;
+    acquire(&isync[dir].dirlock);
+    int ret = copy_path(src, dst, recursive, dir);
+    release(&isync[dir].dirlock);
+    return ret;
+}
+
+// Merge data blocks with identical contents across all files.
+// Returns the number of blocks freed.
+int fs_dedup(void) {
+    static uint64_t hash[NBLOCKS];
+    static int16_t canon[NBLOCKS];
+    int freed = 0;
+    
+    // Every file's blocks are rewritten: stop all data access meanwhile
+    for (int i = 0; i < MAX_FILES; i++) {
+        acquire(&isync[i].lock);
     }
+    acquire(&block_lock);
     
-    // If directory, check if empty
-    if (inodes[idx].type == TYPE_DIR) {
+    for (int b = 0; b < NBLOCKS; b++) {
+        canon[b] = b;
+        if (block_ref[b] == 0) continue;
+        hash[b] = persist_sum(0xcbf29ce484222325UL, blocks[b], BLOCK_SIZE);
+        
+        // The first block seen with this content becomes canonical
+        for (int c = 0; c < b; c++) {
+            if (block_ref[c] == 0 || canon[c] != c || hash[c] != hash[b]) continue;
+            int k = 0;
+            while (k < BLOCK_SIZE && blocks[c][k] == blocks[b][k]) k++;
+            if (k == BLOCK_SIZE) {
+                canon[b] = c;
+                break;
+            }
+        }
+    }
+    
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!inodes[i].used) continue;
+        for (int k = 0; k < MAX_FILE_BLOCKS; k++) {
+            int b = inodes[i].blocks[k];
+            if (b < 0 || canon[b] == b) continue;
+            block_ref[canon[b]]++;
+            if (--block_ref[b] == 0) {
+                blocks_free++;
+                freed++;
+            }
+            inodes[i].blocks[k] = canon[b];
+        }
+    }
+    
+    release(&block_lock);
+    for (int i = 0; i < MAX_FILES; i++) {
+        release(&isync[i].lock);
+    }
+    return freed;
+}
+
+// Set a file's compression mode and repack its contents to match
+int fs_set_compress(const char *path, int mode) {
+    if (mode < FS_COMPRESS_OFF || mode > FS_COMPRESS_AUTO) {
+        return -1;
+    }
+    inode_t *ino = lock_file(path);
+    if (!ino) {
+        return -1;
+    }
+    
+    int ret = -1;
+    acquire(&repack_lock);
+    int size = read_data(ino, repack_buf, ino->size);
+    if (size >= 0) {
+        ino->compress = mode;
+        ret = store_data(ino, repack_buf, size) < 0 ? -1 : 0;
+    }
+    release(&repack_lock);
+    unlock_file(ino);
+    return ret;
+}
+
+// Set the compression mode given to newly created files
+void fs_set_default_compress(int mode) {
+    if (mode >= FS_COMPRESS_OFF && mode <= FS_COMPRESS_AUTO) {
+        default_compress = mode;
+    }
+}
+
+// Collect space usage and compression counters
+void fs_get_stats(fs_stats_t *st) {
+    st->files = st->packed_files = 0;
+    st->logical_bytes = st->stored_bytes = 0;
+    st->packed_logical = st->packed_stored = 0;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!inodes[i].used || inodes[i].type != TYPE_FILE) continue;
+        st->files++;
+        st->logical_bytes += inodes[i].size;
+        st->stored_bytes += inodes[i].stored;
+        if (inodes[i].packed) {
+            st->packed_files++;
+            st->packed_logical += inodes[i].size;
+            st->packed_stored += inodes[i].stored;
+        }
+    }
+    
+    st->blocks_used = st->blocks_shared = st->block_refs = 0;
+    for (int b = 0; b < NBLOCKS; b++) {
+        st->blocks_used += block_ref[b] > 0;
+        st->blocks_shared += block_ref[b] > 1;
+        st->block_refs += block_ref[b];
+    }
+    
+    st->z_bytes = z_bytes;
+    st->z_cycles = z_cycles;
+    st->unz_bytes = unz_bytes;
+    st->unz_cycles = unz_cycles;
+}
+
+// Helper: Remove inode idx from parent and free its blocks. The caller
+// holds parent's dirlock.
+static void free_inode(int parent, int idx) {
+    inode_t *ino = &inodes[idx];
+
+    // Wait out anyone using the data, and leave the slot without blocks
+    acquire(&isync[idx].lock);
+    truncate_blocks(ino, 0);
+    ino->size = 0;
+    seq_write_begin(&isync[parent].seq);
+    ino->used = 0;
+    ino->parent_idx = -1;
+    seq_write_end(&isync[parent].seq);
+    release(&isync[idx].lock);
+}
+
+// Helper: Delete idx from parent, whose dirlock the caller holds
+static int delete_locked(int parent, int idx) {
+    if (inodes[idx].type != TYPE_DIR) {
+        free_inode(parent, idx);
+        return 0;
+    }
+    
+    // Holding the directory's own lock keeps entries from appearing in it
+    int ret = -1;
+    acquire(&isync[idx].dirlock);
+    if (isync[idx].pins == 0) {
+        ret = 0;
         for (int i = 0; i < MAX_FILES; i++) {
             if (inodes[i].used && inodes[i].parent_idx == idx) {
-                return -1; // Directory not empty
+                ret = -1; // Directory not empty
+                break;
             }
         }
+        if (ret == 0) {
+            free_inode(parent, idx);
+        }
+    }
+    release(&isync[idx].dirlock);
+    return ret;
+}
+
+// Helper: Delete a file or empty directory
+static int delete_path(const char *path) {
+    uint32_t gen;
+    int idx = find_path(path, &gen);
+    if (idx <= 0) {
+        return -1; // Not found or trying to delete root
     }
     
-    inodes[idx].used = 0;
-    return 0;
+    int parent = inodes[idx].parent_idx;
+    if (parent < 0) {
+        return -1; // Deleted since the lookup
+    }
+    
+    int ret = -1;
+    acquire(&isync[parent].dirlock);
+    // Still the same entry of the same directory?
+    if (inodes[idx].used && isync[idx].gen == gen && inodes[idx].parent_idx == parent) {
+        ret = delete_locked(parent, idx);
+    }
+    release(&isync[parent].dirlock);
+    return ret;
+}
+
+// Delete a file or empty directory
+int fs_delete(const char *path) {
+    TRACE(TRACE_FS, TEV_FS_DELETE, TRACE_BEGIN, 0, trace_tag(path));
+    int ret = delete_path(path);
+    TRACE(TRACE_FS, TEV_FS_DELETE, TRACE_END, ret, 0);
+    return ret;
 }
@@ -8,6 +8,20 @@
 #define MAX_FILE_SIZE 1024
 #define MAX_PATH 128
 
+// File data lives in a shared pool of fixed-size blocks
+#define BLOCK_SIZE 128
+// Enough for MAX_FILE_SIZE plus the segment headers of a compressed file
+#define MAX_FILE_BLOCKS ((MAX_FILE_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE + 1)
+// Every file at its largest, incompressible and packed. Blocks in use
+// never outnumber the references inodes hold, so writes never run out.
+#define NBLOCKS (MAX_FILES * MAX_FILE_BLOCKS)
+
+// Per-file compression modes
+#define FS_COMPRESS_OFF  0
+#define FS_COMPRESS_ON   1
+#define FS_COMPRESS_AUTO 2   // compress once the file reaches FS_COMPRESS_THRESHOLD
+#define FS_COMPRESS_THRESHOLD 512
+
 typedef enum {
     TYPE_FILE,
     TYPE_DIR
@@ -16,14 +30,46 @@ typedef enum {
 typedef struct {
     char name[MAX_FILENAME];
     file_type_t type;
-    uint32_t size;
-    char data[MAX_FILE_SIZE];
+    uint32_t size;       // Logical file size
+    uint32_t stored;     // Bytes used in blocks[] (== size unless packed)
+    int16_t blocks[MAX_FILE_BLOCKS];  // Data block indices, -1 if unallocated
+    uint16_t tail;       // Offset of the last segment header (packed only)
+    uint8_t compress;    // FS_COMPRESS_* mode
+    uint8_t packed;      // 1 if blocks[] hold compressed segments
     int parent_idx;  // Index of parent directory (-1 for root)
     int used;        // 1 if this inode is in use
 } inode_t;
 
+// Space and compression statistics
+typedef struct {
+    uint32_t files;
+    uint32_t packed_files;
+    uint32_t logical_bytes;    // sum of file sizes
+    uint32_t stored_bytes;     // bytes those files occupy in blocks
+    uint32_t packed_logical;   // logical bytes held in packed files
+    uint32_t packed_stored;
+    uint32_t blocks_used;
+    uint32_t blocks_shared;    // blocks referenced by more than one file
+    uint32_t block_refs;       // blocks files would use without sharing
+    uint64_t z_bytes;          // bytes fed to the compressor
+    uint64_t z_cycles;
+    uint64_t unz_bytes;        // bytes produced by the decompressor
+    uint64_t unz_cycles;
+} fs_stats_t;
+
+// Per-context state: each task on hart 0, each other hart and, on the
+// host, each thread has its own working directory. fs_context() is
+// provided by the environment.
+typedef struct {
+    int cwd;             // Current working directory index
+} fs_context_t;
+
+fs_context_t *fs_context(void);
+
 // Filesystem API
-void fs_init(void);
+int fs_init(void);
+void fs_persist_seal(void);
+void fs_persist_discard(void);
 int fs_create(const char *path, file_type_t type);
 int fs_write(const char *path, const char *data, uint32_t size);
 int fs_append(const char *path, const char *data, uint32_t size);
@@ -36,6 +82,11 @@ void fs_set_cwd(int idx);
 const char* fs_get_name(int idx);
 file_type_t fs_get_type(int idx);
 uint32_t fs_get_size(int idx);
-const char* fs_get_data(int idx);
+int fs_set_compress(const char *path, int mode);
+void fs_set_default_compress(int mode);
+void fs_get_stats(fs_stats_t *st);
+int fs_copy(const char *src, const char *dst, int recursive);
+int fs_dedup(void);
+int fs_check(void);
 
 #endif
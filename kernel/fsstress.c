@@ -0,0 +1,217 @@
+#include "fsstress.h"
+#include "fs.h"
+#include "hart.h"
+#include "param.h"
+#include "perf.h"
+#include "string.h"
+
+#define STRESS_DIR    "stress.tmp"
+#define STRESS_SHARED "shared"
+#define CHECK_EVERY   8      // rounds between fs_check() checkpoints
+
+// Sense-reversing barrier for the workers running at the same time
+struct barrier {
+    uint32_t n;
+    volatile uint32_t count;
+    volatile uint32_t phase;
+};
+
+struct worker {
+    int id;
+    int rounds;
+    int dir;
+    int leader;              // Runs the checkpoint for its group
+    struct barrier *group;
+    uint32_t ops;
+    uint32_t errors;
+    uint32_t shared;
+};
+
+static void barrier_wait(struct barrier *b) {
+    uint32_t phase = __atomic_load_n(&b->phase, __ATOMIC_ACQUIRE);
+    if (__atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == b->n) {
+        b->count = 0;
+        __atomic_store_n(&b->phase, phase + 1, __ATOMIC_RELEASE);
+    } else {
+        while (__atomic_load_n(&b->phase, __ATOMIC_ACQUIRE) == phase)
+            ;
+    }
+}
+
+// Helper: Count a result that must hold
+static void expect(struct worker *w, int ok) {
+    w->ops++;
+    if (!ok) {
+        w->errors++;
+    }
+}
+
+// Helper: Content of round r: text for even rounds, so that compressed
+// files see both compressible and incompressible data
+static void fill(char *buf, uint32_t len, int id, int r) {
+    uint32_t x = id * 2654435761u + r;
+    for (uint32_t i = 0; i < len; i++) {
+        if (r & 1) {
+            x = x * 1103515245u + 12345;
+            buf[i] = x >> 16;
+        } else {
+            buf[i] = 'a' + (id + r + i % 13) % 26;
+        }
+    }
+}
+
+// Helper: Whether the first n bytes of a and b match
+static int same(const char *a, const char *b, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void stress_worker(void *arg) {
+    struct worker *w = arg;
+    char name[4] = { 'f', '0' + w->id, '\0' };
+    char copy[4] = { 'c', '0' + w->id, '\0' };
+    char sub[4] = { 'd', '0' + w->id, '\0' };
+    char buf[MAX_FILE_SIZE / 2];
+    char out[MAX_FILE_SIZE];
+
+    fs_set_cwd(w->dir);
+    for (int r = 0; r < w->rounds; r++) {
+        uint32_t len = 1 + (r * 97u + w->id * 31u) % sizeof(buf);
+        fill(buf, len, w->id, r);
+
+        // Private file: every step must succeed and read back exactly
+        expect(w, fs_create(name, TYPE_FILE) >= 0);
+        expect(w, fs_set_compress(name, r % 3) == 0);
+        expect(w, fs_write(name, buf, len) == (int)len);
+        expect(w, fs_append(name, buf, len) == (int)len);
+        int n = fs_read(name, out, sizeof(out));
+        expect(w, n == (int)(2 * len) && same(out, buf, len) && same(out + len, buf, len));
+
+        if (r % 4 == 0) {
+            // Writing a copy must not show through to the original
+            expect(w, fs_copy(name, copy, 0) >= 0);
+            expect(w, fs_write(copy, "x", 1) == 1);
+            n = fs_read(name, out, sizeof(out));
+            expect(w, n == (int)(2 * len) && same(out, buf, len));
+            expect(w, fs_delete(copy) == 0);
+        } else if (r % 4 == 1) {
+            expect(w, fs_create(sub, TYPE_DIR) >= 0);
+            expect(w, fs_delete(sub) == 0);
+        }
+
+        // Contended name: any step may lose the race, none may corrupt
+        if (fs_create(STRESS_SHARED, TYPE_FILE) >= 0) {
+            w->shared++;
+        }
+        if (r % CHECK_EVERY == CHECK_EVERY - 1) {
+            // Quiesce the group mid-run, while racing creates could
+            // have left duplicates behind
+            barrier_wait(w->group);
+            if (w->leader) {
+                expect(w, fs_check() == 0);
+            }
+            barrier_wait(w->group);
+        }
+        fs_append(STRESS_SHARED, name, 2);
+        fs_read(STRESS_SHARED, out, sizeof(out));
+        fs_delete(STRESS_SHARED);
+        w->ops += 4;
+
+        if (w->id == 0 && r % 16 == 15) {
+            fs_dedup();
+            w->ops++;
+        }
+
+        expect(w, fs_delete(name) == 0);
+    }
+    fs_set_cwd(0);
+}
+
+// Helper: Count directory entries
+static int nentries;
+static void count_entry(const char *name, file_type_t type, uint32_t size) {
+    (void)name;
+    (void)type;
+    (void)size;
+    nentries++;
+}
+
+int fsstress_run(int workers, int rounds, struct fsstress_result *res) {
+    static struct worker w[NCPU];
+    static struct barrier group[NCPU];
+    int started[NCPU];
+    fs_stats_t st;
+
+    if (workers < 1) workers = 1;
+    if (workers > NCPU) workers = NCPU;
+
+    int saved_cwd = fs_get_cwd();
+    fs_set_cwd(0);
+    fs_get_stats(&st);
+    uint32_t blocks_before = st.blocks_used;
+    int dir = fs_create(STRESS_DIR, TYPE_DIR);
+    if (dir < 0) {
+        fs_set_cwd(saved_cwd);
+        return -1;
+    }
+
+    // Workers 1.. run on their own harts if they can be started, together
+    // with worker 0 on this hart as group 0. Any that cannot run on this
+    // hart afterwards, one at a time, each in a group of its own.
+    uint64_t t = perf_cycles();
+    group[0] = (struct barrier){ .n = 1 };
+    started[0] = 0;
+    res->harts = 1;
+    for (int i = 0; i < workers; i++) {
+        w[i] = (struct worker){ .id = i, .rounds = rounds, .dir = dir,
+                                .leader = i == 0, .group = &group[0] };
+    }
+    for (int i = 1; i < workers; i++) {
+        group[0].n++;   // Before the worker can reach a checkpoint
+        started[i] = hart_start(i, stress_worker, &w[i]) == 0;
+        if (!started[i]) {
+            group[0].n--;
+            group[i] = (struct barrier){ .n = 1 };
+            w[i].group = &group[i];
+            w[i].leader = 1;
+        }
+        res->harts += started[i];
+    }
+    for (int i = 0; i < workers; i++) {
+        if (!started[i]) {
+            stress_worker(&w[i]);
+        }
+    }
+    for (int i = 1; i < workers; i++) {
+        if (started[i]) {
+            hart_wait(i);
+        }
+    }
+    res->cycles = perf_cycles() - t;
+
+    res->ops = res->errors = res->shared = 0;
+    for (int i = 0; i < workers; i++) {
+        res->ops += w[i].ops;
+        res->errors += w[i].errors;
+        res->shared += w[i].shared;
+    }
+
+    // The contended file may survive; nothing else should
+    fs_set_cwd(dir);
+    fs_delete(STRESS_SHARED);
+    fs_set_cwd(0);
+    nentries = 0;
+    fs_list(dir, count_entry);
+    res->leftover = nentries;
+    fs_delete(STRESS_DIR);
+
+    res->check = fs_check();
+    fs_get_stats(&st);
+    res->leaked = st.blocks_used > blocks_before ? st.blocks_used - blocks_before : 0;
+    fs_set_cwd(saved_cwd);
+    return 0;
+}
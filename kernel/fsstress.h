@@ -0,0 +1,24 @@
+#ifndef FSSTRESS_H
+#define FSSTRESS_H
+
+#include "types.h"
+
+// Concurrent filesystem stress test: workers on separate harts create,
+// write, append, read back, copy and delete their own files in a shared
+// directory while fighting over one common name. Afterwards the
+// structural invariants are checked.
+struct fsstress_result {
+    int harts;             // Harts that ran a worker (the rest ran on hart 0)
+    uint32_t ops;
+    uint32_t errors;       // Data mismatches and operations that must not fail
+    uint32_t shared;       // Successful creates of the contended name
+    int leftover;          // Entries left in the test directory
+    int check;             // fs_check() afterwards
+    uint32_t leaked;       // Blocks in use afterwards beyond those before
+    uint64_t cycles;
+};
+
+// Returns -1 if the test directory could not be set up
+int fsstress_run(int workers, int rounds, struct fsstress_result *res);
+
+#endif
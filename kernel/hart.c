@@ -0,0 +1,90 @@
+#include "hart.h"
+#include "param.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "trap.h"
+#include "fs.h"
+#include "task.h"
+#include "prof.h"
+
+// Per-hart state
+struct hart {
+    void (*volatile fn)(void *);  // Work handed over by hart_start()
+    void *arg;
+    volatile int busy;            // Set by hart_start(), cleared when fn returns
+    fs_context_t fs;              // This hart's working directory (not hart 0)
+};
+
+static struct hart harts[NCPU];
+
+// The fs keeps one context per task on hart 0 and one per other hart
+fs_context_t *fs_context(void) {
+    int id = r_mhartid();
+    if (id == 0) {
+        return task_fs_context();
+    }
+    return &harts[id].fs;
+}
+
+// Helper: Raise a machine software interrupt on a hart
+static void send_ipi(int id, uint32_t pending) {
+    *(volatile uint32_t *)CLINT_MSIP(id) = pending;
+}
+
+// Secondary harts 1..NCPU-1 come here from entry.S on their own stacks.
+// Only the software interrupt is enabled, and mstatus.MIE stays off: wfi
+// returns when it is pending, without taking a trap.
+void hart_park(void) {
+    int id = r_mhartid();
+    struct hart *h = &harts[id];
+
+    trap_init();
+    w_mie(MIE_MSIE);
+    while (1) {
+        asm volatile("wfi");
+        send_ipi(id, 0);
+        void (*fn)(void *) = __atomic_exchange_n(&h->fn, 0, __ATOMIC_ACQUIRE);
+        if (fn) {
+            prof_hart_enter();
+            fn(h->arg);
+            prof_hart_leave();
+            __atomic_store_n(&h->busy, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// Run fn(arg) on hart id. Returns -1 if the hart is busy or does not pick
+// the work up within 10ms (QEMU was started with fewer harts).
+int hart_start(int id, void (*fn)(void *), void *arg) {
+    if (id <= 0 || id >= NCPU || harts[id].busy) {
+        return -1;
+    }
+    struct hart *h = &harts[id];
+
+    h->arg = arg;
+    h->busy = 1;
+    __atomic_store_n(&h->fn, fn, __ATOMIC_RELEASE);
+    send_ipi(id, 1);
+
+    uint64_t deadline = r_time() + TIMEBASE_HZ / 100;
+    while (__atomic_load_n(&h->fn, __ATOMIC_ACQUIRE) != 0) {
+        if (r_time() > deadline) {
+            // Take the work back unless the hart got to it just now
+            if (__atomic_exchange_n(&h->fn, 0, __ATOMIC_ACQUIRE) == fn) {
+                h->busy = 0;
+                return -1;
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+// Wait until the work given to hart id has returned
+void hart_wait(int id) {
+    if (id <= 0 || id >= NCPU) {
+        return;
+    }
+    while (__atomic_load_n(&harts[id].busy, __ATOMIC_ACQUIRE))
+        ;
+}
@@ -0,0 +1,10 @@
+#ifndef HART_H
+#define HART_H
+
+// Secondary harts wait in hart_park() until hart_start() hands them a
+// function to run. Hart 0 runs the shell and is never started this way.
+int hart_start(int id, void (*fn)(void *), void *arg);  // -1 if unavailable
+void hart_wait(int id);
+void hart_park(void);  // called from entry.S
+
+#endif
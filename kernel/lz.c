@@ -0,0 +1,122 @@
+#include "lz.h"
+
+#define MIN_MATCH  4
+#define HASH_BITS  8
+#define MAX_OFFSET 0xffff
+
+static inline uint32_t read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Helper: Write a length continuation (255, 255, ..., rest); -1 on overflow
+static int put_length(uint8_t *dst, int op, int cap, int n) {
+    while (n >= 255) {
+        if (op >= cap) return -1;
+        dst[op++] = 255;
+        n -= 255;
+    }
+    if (op >= cap) return -1;
+    dst[op++] = n;
+    return op;
+}
+
+// Helper: Emit one sequence. mlen == 0 marks the final, literal-only one.
+static int put_sequence(uint8_t *dst, int op, int cap, const uint8_t *lit,
+                        int nlit, int offset, int mlen) {
+    int mcode = mlen ? mlen - MIN_MATCH : 0;
+
+    if (op >= cap) return -1;
+    dst[op++] = ((nlit < 15 ? nlit : 15) << 4) | (mcode < 15 ? mcode : 15);
+    if (nlit >= 15 && (op = put_length(dst, op, cap, nlit - 15)) < 0) return -1;
+
+    if (op + nlit > cap) return -1;
+    for (int i = 0; i < nlit; i++) {
+        dst[op++] = lit[i];
+    }
+
+    if (mlen == 0) return op;
+
+    if (op + 2 > cap) return -1;
+    dst[op++] = offset & 0xff;
+    dst[op++] = offset >> 8;
+    if (mcode >= 15 && (op = put_length(dst, op, cap, mcode - 15)) < 0) return -1;
+    return op;
+}
+
+int lz_compress(const uint8_t *src, int len, uint8_t *dst, int cap) {
+    int table[1 << HASH_BITS];
+    int ip = 0, anchor = 0, op = 0;
+
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+        table[i] = -1;
+    }
+
+    while (ip + MIN_MATCH <= len) {
+        uint32_t v = read32(src + ip);
+        uint32_t h = hash4(v);
+        int ref = table[h];
+        table[h] = ip;
+
+        if (ref < 0 || ip - ref > MAX_OFFSET || read32(src + ref) != v) {
+            ip++;
+            continue;
+        }
+
+        int mlen = MIN_MATCH;
+        while (ip + mlen < len && src[ref + mlen] == src[ip + mlen]) {
+            mlen++;
+        }
+        op = put_sequence(dst, op, cap, src + anchor, ip - anchor, ip - ref, mlen);
+        if (op < 0) return -1;
+        ip += mlen;
+        anchor = ip;
+    }
+
+    return put_sequence(dst, op, cap, src + anchor, len - anchor, 0, 0);
+}
+
+// Helper: Read a length continuation; -1 if it runs off the input
+static int get_length(const uint8_t *src, int *ip, int len, int n) {
+    uint8_t b;
+    do {
+        if (*ip >= len) return -1;
+        b = src[(*ip)++];
+        n += b;
+    } while (b == 255);
+    return n;
+}
+
+int lz_decompress(const uint8_t *src, int len, uint8_t *dst, int cap) {
+    int ip = 0, op = 0;
+
+    while (ip < len) {
+        uint8_t token = src[ip++];
+
+        int nlit = token >> 4;
+        if (nlit == 15 && (nlit = get_length(src, &ip, len, nlit)) < 0) return -1;
+        if (nlit > len - ip || nlit > cap - op) return -1;
+        for (int i = 0; i < nlit; i++) {
+            dst[op++] = src[ip++];
+        }
+
+        if (ip == len) break;  // final sequence has no match
+
+        if (len - ip < 2) return -1;
+        int offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        int mlen = token & 15;
+        if (mlen == 15 && (mlen = get_length(src, &ip, len, mlen)) < 0) return -1;
+        mlen += MIN_MATCH;
+
+        if (offset == 0 || offset > op || mlen > cap - op) return -1;
+        // Byte copy: overlapping matches repeat the pattern
+        for (int i = 0; i < mlen; i++, op++) {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return op;
+}
@@ -0,0 +1,18 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include "types.h"
+
+// LZ4-style block codec: a sequence of (literals, back-reference) pairs,
+// each introduced by a token byte of two 4-bit lengths, with offsets of
+// up to 64KB. Meant for small blocks; no framing or checksums.
+
+// Compress len bytes of src into dst. Returns the compressed size, or -1
+// if it would not fit in cap bytes.
+int lz_compress(const uint8_t *src, int len, uint8_t *dst, int cap);
+
+// Decompress len bytes of src into dst. Returns the decompressed size, or
+// -1 if the input is malformed or would overflow cap bytes.
+int lz_decompress(const uint8_t *src, int len, uint8_t *dst, int cap);
+
+#endif
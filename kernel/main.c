@@ -3,6 +3,14 @@
 #include "types.h"
 #include "fs.h"
 #include "shell.h"
+#include "riscv.h"
+#include "trap.h"
+#include "bootstat.h"
+#include "trace.h"
+#include "perf.h"
+#include "bench.h"
+#include "memlayout.h"
+#include "task.h"
 
 #define CMD_BUF_SIZE 128
 
@@ -11,18 +19,57 @@ void execute_command(const char *cmd);
 static inline void mmio_write(uint64_t addr, uint64_t value) {
   *(volatile uint64_t *)addr = value;
 }
-extern void _start(void); //from entry.s
+extern void _start(void); //from entry.S
+
+// Warm restart: quiesce interrupts and re-enter _start, which resets the
+// stack and clears .bss, so every subsystem starts from a clean state.
+// With keep_fs the filesystem is sealed first so fs_init() reattaches it.
+static void reboot(int keep_fs) {
+  console_flush();
+  intr_off();
+  w_mie(0);
+  if (keep_fs) {
+    fs_persist_seal();
+  } else {
+    fs_persist_discard();
+  }
+  void (*restart)(void) = _start;
+  restart();
+}
+
+// Power off QEMU through the virt test device
+static void poweroff(void) {
+  console_flush();
+  intr_off();
+  *(volatile uint32_t *)VIRT_TEST = FINISHER_PASS;  // 32-bit register
+  while (1) {
+    asm volatile("wfi");
+  }
+}
 
 int main() {
 
   char buf[CMD_BUF_SIZE];
   int idx = 0;
 
+  trap_init();
+  perf_init();
+  task_init();
+  bootstat_mark(BOOT_TRAP);
+
+  console_init();
+  bootstat_mark(BOOT_CONSOLE);
+
   // Initialize filesystem
-  fs_init();
+  int restored = fs_init();
+  bootstat_mark(BOOT_FS);
 
   console_puts("Tiny RISC-V Kernel with Filesystem\n");
+  if (restored) {
+    console_puts("Filesystem restored after warm reboot.\n");
+  }
   console_puts("Type 'help' for commands.\n> ");
+  bootstat_mark(BOOT_PROMPT);
   // console_init();
   // console_puts("Hello from kernel");
   //
@@ -47,11 +94,64 @@ int main() {
   }
 }
 
+// time - run a command and report wall time and hardware counters
+static void time_command(const char *cmd) {
+  struct perf_sample start, end;
+
+  if (cmd[0] == '\0') {
+    console_puts("Usage: time <command>\n");
+    return;
+  }
+
+  perf_read(&start);
+  execute_command(cmd);
+  perf_read(&end);
+  perf_report(&start, &end);
+}
+
+// Body of a background job
+static void run_job(const char *cmd) {
+  execute_command(cmd);
+}
+
+// Start "cmd &" as a background job
+static void start_job(const char *cmd) {
+  char line[CMD_BUF_SIZE];
+  int n = strlen(cmd);
+
+  // Drop the '&' and the spaces around it
+  while (n > 0 && (cmd[n - 1] == '&' || cmd[n - 1] == ' ')) n--;
+  if (n >= CMD_BUF_SIZE) n = CMD_BUF_SIZE - 1;
+  for (int k = 0; k < n; k++) line[k] = cmd[k];
+  line[n] = '\0';
+  if (n == 0) {
+    console_puts("Usage: <command> &\n");
+    return;
+  }
+
+  int id = task_spawn(run_job, line);
+  if (id < 0) {
+    console_puts("Too many jobs\n");
+    return;
+  }
+  console_putc('[');
+  console_putdec(id);
+  console_puts("] ");
+  console_puts(line);
+  console_putc('\n');
+}
+
 void execute_command(const char *cmd) {
   // Parse command and arguments
   char command[64];
   const char *args = cmd;
   int i = 0;
+  int len = strlen(cmd);
+
+  if (len > 0 && cmd[len - 1] == '&') {
+    start_job(cmd);
+    return;
+  }
   
   // Extract command (first word)
   while (*args && *args != ' ' && i < 63) {
@@ -61,6 +161,8 @@ void execute_command(const char *cmd) {
   
   // Skip spaces to get to arguments
   while (*args == ' ') args++;
+
+  TRACE(TRACE_CMD, TEV_CMD, TRACE_BEGIN, 0, trace_tag(command));
   
   // Execute commands
   if (strcmp(command, "help") == 0) {
@@ -79,7 +181,24 @@ void execute_command(const char *cmd) {
     console_puts("  echo TEXT > FILE  - write text to file\n");
     console_puts("  echo TEXT >> FILE - append text to file\n");
     console_puts("  sh FILE      - execute shell script\n");
-    console_puts("  reboot       - resets QEMU\n");
+    console_puts("  cp [-r] SRC DST - copy file or tree (shares data until written)\n");
+    console_puts("  dedup        - merge identical data blocks\n");
+    console_puts("  compress FILE on|off|auto - set file compression\n");
+    console_puts("  fsstat       - show space and compression stats\n");
+    console_puts("  fsstress [N] [ROUNDS] - concurrent fs workers on N harts, then check\n");
+    console_puts("  bootstat     - show boot phase timings\n");
+    console_puts("  trace ...    - tracepoints: on/off [fs|cmd|cons|all], clear, dump\n");
+    console_puts("  prof ...     - sampling profiler: start [HZ], stop, dump\n");
+    console_puts("  time CMD     - run CMD, report time, cycles, instret\n");
+    console_puts("  CMD &        - run CMD as a background job\n");
+    console_puts("  jobs         - list background jobs\n");
+    console_puts("  fg [N]       - bring job N (default: highest-numbered) to the foreground\n");
+    console_puts("  wait [N]     - wait for job N, or for all jobs\n");
+    console_puts("  bench [NAME] - run fs benchmarks (all, or names starting with NAME)\n");
+    console_puts("  consbench rx|tx BYTES - console throughput on the current backend\n");
+    console_puts("  reboot       - warm restart, keeps files\n");
+    console_puts("  reboot cold  - restart with a fresh filesystem\n");
+    console_puts("  poweroff     - power off QEMU\n");
   } else if (strcmp(command, "hello") == 0) {
     console_puts("Hello, user!\n");
   } else if (strcmp(command, "clear") == 0) {
@@ -104,11 +223,49 @@ void execute_command(const char *cmd) {
     shell_echo(args);
   } else if (strcmp(command, "sh") == 0) {
     shell_sh(args);
+  } else if (strcmp(command, "cp") == 0) {
+    shell_cp(args);
+  } else if (strcmp(command, "dedup") == 0) {
+    shell_dedup(args);
+  } else if (strcmp(command, "compress") == 0) {
+    shell_compress(args);
+  } else if (strcmp(command, "fsstat") == 0) {
+    shell_fsstat(args);
+  } else if (strcmp(command, "fsstress") == 0) {
+    shell_fsstress(args);
+  } else if (strcmp(command, "bootstat") == 0) {
+    bootstat_print();
+  } else if (strcmp(command, "trace") == 0) {
+    shell_trace(args);
+  } else if (strcmp(command, "prof") == 0) {
+    shell_prof(args);
+  } else if (strcmp(command, "time") == 0) {
+    time_command(args);
+  } else if (strcmp(command, "jobs") == 0) {
+    shell_jobs(args);
+  } else if (strcmp(command, "fg") == 0) {
+    shell_fg(args);
+  } else if (strcmp(command, "wait") == 0) {
+    shell_wait(args);
+  } else if (strcmp(command, "bench") == 0) {
+    bench_run(args);
+  } else if (strcmp(command, "consbench") == 0) {
+    bench_console(args);
   } else if (strcmp(command, "reboot") == 0) {
-    console_puts("Rebooting...\n");
-    void (*restart)(void) = _start;
-    restart();
+    if (strcmp(args, "cold") == 0) {
+      console_puts("Rebooting (cold)...\n");
+      reboot(0);
+    } else if (args[0] == '\0') {
+      console_puts("Rebooting...\n");
+      reboot(1);
+    } else {
+      console_puts("Usage: reboot [cold]\n");
+    }
+  } else if (strcmp(command, "poweroff") == 0) {
+    poweroff();
   } else if (command[0] != '\0') {
     console_puts("Unknown command. Type 'help'.\n");
   }
+
+  TRACE(TRACE_CMD, TEV_CMD, TRACE_END, 0, 0);
 }
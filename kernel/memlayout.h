@@ -0,0 +1,21 @@
+#ifndef MEMLAYOUT_H
+#define MEMLAYOUT_H
+
+// QEMU virt machine physical memory layout
+
+// SiFive test finisher: write FINISHER_PASS to power off
+#define VIRT_TEST      0x100000L
+#define FINISHER_PASS  0x5555
+
+// virtio-mmio transports, one device per slot
+#define VIRTIO0             0x10001000L
+#define VIRTIO_MMIO_STRIDE  0x1000
+#define VIRTIO_MMIO_SLOTS   8
+
+// Core-local interruptor: software interrupts and machine timer
+#define CLINT               0x2000000L
+#define CLINT_MSIP(hart)    (CLINT + 4 * (hart))
+#define CLINT_MTIMECMP(hart) (CLINT + 0x4000 + 8 * (hart))
+#define CLINT_MTIME         (CLINT + 0xBFF8)
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef PARAM_H
+#define PARAM_H
+
+// Also included by entry.S, so plain #defines only
+
+#define NCPU 4               // maximum number of harts the kernel keeps state for
+#define HART_STACK_SHIFT 13  // secondary hart stacks are 1 << 13 = 8KB
+#define HART_STACK (1 << HART_STACK_SHIFT)
+
+#endif
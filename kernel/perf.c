@@ -0,0 +1,75 @@
+#include "perf.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "console.h"
+
+// mhpmevent encodings QEMU counts (same values as its SBI PMU event map).
+// The counters stay at zero on platforms that do not implement an event.
+static const struct {
+    uint64_t event;
+    const char *name;
+} hpm_events[PERF_NHPM] = {
+    { 0x10019, "dtlb_rd_miss" },
+    { 0x1001b, "dtlb_wr_miss" },
+    { 0x10021, "itlb_miss" },
+};
+
+// Make mcycle/minstret/mhpmcounter3..5 count, and bind the events
+void perf_init(void) {
+    asm volatile("csrw 0x320, zero");   // mcountinhibit: inhibit nothing
+    asm volatile("csrw mhpmevent3, %0" : : "r"(hpm_events[0].event));
+    asm volatile("csrw mhpmevent4, %0" : : "r"(hpm_events[1].event));
+    asm volatile("csrw mhpmevent5, %0" : : "r"(hpm_events[2].event));
+    asm volatile("csrw mhpmcounter3, zero");
+    asm volatile("csrw mhpmcounter4, zero");
+    asm volatile("csrw mhpmcounter5, zero");
+}
+
+void perf_read(struct perf_sample *s) {
+    s->time = *(volatile uint64_t *)CLINT_MTIME;
+    asm volatile("csrr %0, mcycle" : "=r"(s->cycle));
+    asm volatile("csrr %0, minstret" : "=r"(s->instret));
+    asm volatile("csrr %0, mhpmcounter3" : "=r"(s->hpm[0]));
+    asm volatile("csrr %0, mhpmcounter4" : "=r"(s->hpm[1]));
+    asm volatile("csrr %0, mhpmcounter5" : "=r"(s->hpm[2]));
+}
+
+// Cycle counter for code that must not depend on riscv.h (fs.c)
+uint64_t perf_cycles(void) {
+    return r_mcycle();
+}
+
+// Print the counter deltas between two snapshots
+void perf_report(const struct perf_sample *start, const struct perf_sample *end) {
+    uint64_t ticks = end->time - start->time;
+    uint64_t cycles = end->cycle - start->cycle;
+    uint64_t instret = end->instret - start->instret;
+
+    console_puts("real ");
+    console_putdec(ticks * 1000000UL / TIMEBASE_HZ);
+    console_puts(" us (");
+    console_putdec(ticks);
+    console_puts(" ticks)\n");
+
+    console_puts("cycles ");
+    console_putdec(cycles);
+    console_puts("  instret ");
+    console_putdec(instret);
+    if (cycles > 0) {
+        uint64_t ipc = instret * 100 / cycles;
+        console_puts("  ipc ");
+        console_putdec(ipc / 100);
+        console_putc('.');
+        console_putc('0' + (ipc / 10) % 10);
+        console_putc('0' + ipc % 10);
+    }
+    console_putc('\n');
+
+    for (int i = 0; i < PERF_NHPM; i++) {
+        console_puts(i ? "  " : "");
+        console_puts(hpm_events[i].name);
+        console_putc(' ');
+        console_putdec(end->hpm[i] - start->hpm[i]);
+    }
+    console_putc('\n');
+}
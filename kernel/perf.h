@@ -0,0 +1,21 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "types.h"
+
+#define PERF_NHPM 3   // programmable counters used: mhpmcounter3..5
+
+// A snapshot of the hardware counters
+struct perf_sample {
+    uint64_t time;             // CLINT mtime
+    uint64_t cycle;            // mcycle
+    uint64_t instret;          // minstret
+    uint64_t hpm[PERF_NHPM];   // mhpmcounter3..5
+};
+
+void perf_init(void);
+void perf_read(struct perf_sample *s);
+uint64_t perf_cycles(void);
+void perf_report(const struct perf_sample *start, const struct perf_sample *end);
+
+#endif
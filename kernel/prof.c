@@ -0,0 +1,130 @@
+#include "prof.h"
+#include "param.h"
+#include "riscv.h"
+#include "memlayout.h"
+#include "console.h"
+
+extern char __text_start[], __text_end[];  // from kernel.ld
+
+// Per-hart histogram of sampled mepc values
+struct prof_hist {
+    uint32_t count[PROF_BUCKETS];
+    uint64_t outside;   // samples beyond the histogram's range
+    uint64_t total;
+};
+
+static struct prof_hist hist[NCPU];
+static uint64_t prof_interval;   // timer ticks between samples; 0 when stopped
+static uint32_t prof_hz;
+
+static inline void set_timer(uint64_t hart, uint64_t when) {
+    *(volatile uint64_t *)CLINT_MTIMECMP(hart) = when;
+}
+
+static inline uint64_t read_mtime(void) {
+    return *(volatile uint64_t *)CLINT_MTIME;
+}
+
+// Start sampling at hz samples per second. Histograms keep accumulating
+// across start/stop; a fresh start after a dump begins from zero.
+int prof_start(uint32_t hz) {
+    if (hz == 0 || hz > PROF_MAX_HZ) {
+        return -1;
+    }
+
+    uint64_t hart = r_mhartid();
+    prof_hz = hz;
+    prof_interval = TIMEBASE_HZ / hz;
+    set_timer(hart, read_mtime() + prof_interval);
+    w_mie(r_mie() | MIE_MTIE);
+    intr_on();
+    return 0;
+}
+
+void prof_stop(void) {
+    w_mie(r_mie() & ~MIE_MTIE);
+    set_timer(r_mhartid(), ~0UL);
+    prof_interval = 0;
+}
+
+// Secondary harts park with interrupts off, so they only sample the work
+// they run: each arms its own timer when it picks work up while profiling
+// is on. Nothing but the timer can interrupt it, as no IPI is sent to a
+// busy hart and the last one was cleared before the work started.
+void prof_hart_enter(void) {
+    uint64_t interval = __atomic_load_n(&prof_interval, __ATOMIC_RELAXED);
+    if (interval == 0) {
+        return;
+    }
+    set_timer(r_mhartid(), read_mtime() + interval);
+    w_mie(r_mie() | MIE_MTIE);
+    intr_on();
+}
+
+void prof_hart_leave(void) {
+    intr_off();
+    w_mie(r_mie() & ~MIE_MTIE);
+    set_timer(r_mhartid(), ~0UL);
+}
+
+void prof_tick(uint64_t pc) {
+    uint64_t hart = r_mhartid();
+
+    if (prof_interval == 0 || hart >= NCPU) {
+        // Not profiling: silence the timer
+        set_timer(hart, ~0UL);
+        return;
+    }
+
+    struct prof_hist *h = &hist[hart];
+    uint64_t off = (pc - (uint64_t)__text_start) >> PROF_SHIFT;
+    if (pc >= (uint64_t)__text_start && off < PROF_BUCKETS) {
+        h->count[off]++;
+    } else {
+        h->outside++;
+    }
+    h->total++;
+
+    // Re-arm relative to now so a slow handler cannot cause a storm
+    set_timer(hart, read_mtime() + prof_interval);
+}
+
+// Dump non-empty buckets as "P <hart> <pc> <count>" (pc in hex) and
+// reset the histograms. `make prof-report` symbolizes the output.
+void prof_dump(void) {
+    uint64_t base = (uint64_t)__text_start;
+
+    console_puts("# prof begin hz=");
+    console_putdec(prof_hz);
+    console_puts(" shift=");
+    console_putdec(PROF_SHIFT);
+    console_putc('\n');
+
+    for (int i = 0; i < NCPU; i++) {
+        struct prof_hist *h = &hist[i];
+        if (h->total == 0) continue;
+
+        console_puts("# hart ");
+        console_putdec(i);
+        console_puts(" samples ");
+        console_putdec(h->total);
+        console_puts(" outside ");
+        console_putdec(h->outside);
+        console_putc('\n');
+
+        for (int b = 0; b < PROF_BUCKETS; b++) {
+            if (h->count[b] == 0) continue;
+            console_puts("P ");
+            console_putx(i);
+            console_putc(' ');
+            console_putx(base + ((uint64_t)b << PROF_SHIFT));
+            console_putc(' ');
+            console_putdec(h->count[b]);
+            console_putc('\n');
+            h->count[b] = 0;
+        }
+        h->outside = 0;
+        h->total = 0;
+    }
+    console_puts("# prof end\n");
+}
@@ -0,0 +1,19 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include "types.h"
+
+#define PROF_DEFAULT_HZ 1000
+#define PROF_MAX_HZ     10000  // 1000 timer ticks, well above the cost of a sample
+#define PROF_SHIFT      3      // one bucket per 8 bytes of text
+#define PROF_BUCKETS    4096   // covers 32KB of kernel text
+
+// Timer-driven PC sampling profiler
+int prof_start(uint32_t hz);
+void prof_stop(void);
+void prof_dump(void);
+void prof_hart_enter(void);    // around work run on a secondary hart
+void prof_hart_leave(void);
+void prof_tick(uint64_t pc);   // called from kernel_trap on a timer interrupt
+
+#endif
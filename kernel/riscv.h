@@ -0,0 +1,89 @@
+#ifndef RISCV_H
+#define RISCV_H
+
+#include "types.h"
+
+// QEMU virt mtime/rdtime frequency
+#define TIMEBASE_HZ 10000000UL
+
+// mstatus bits
+#define MSTATUS_MIE (1L << 3)
+
+// mie / mip bits
+#define MIE_MSIE (1L << 3)
+#define MIE_MTIE (1L << 7)
+
+// mcause: top bit set for interrupts
+#define MCAUSE_INTR (1UL << 63)
+#define MCAUSE_MTI  7   // machine timer interrupt
+
+static inline uint64_t r_mhartid(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mhartid" : "=r"(x));
+    return x;
+}
+
+static inline uint64_t r_mstatus(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mstatus" : "=r"(x));
+    return x;
+}
+
+static inline void w_mstatus(uint64_t x) {
+    asm volatile("csrw mstatus, %0" : : "r"(x));
+}
+
+static inline uint64_t r_mie(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mie" : "=r"(x));
+    return x;
+}
+
+static inline void w_mie(uint64_t x) {
+    asm volatile("csrw mie, %0" : : "r"(x));
+}
+
+static inline void w_mtvec(uint64_t x) {
+    asm volatile("csrw mtvec, %0" : : "r"(x));
+}
+
+static inline uint64_t r_mcause(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mcause" : "=r"(x));
+    return x;
+}
+
+static inline uint64_t r_mepc(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mepc" : "=r"(x));
+    return x;
+}
+
+static inline uint64_t r_mtval(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mtval" : "=r"(x));
+    return x;
+}
+
+// Read the platform timer (ticks at TIMEBASE_HZ)
+static inline uint64_t r_time(void) {
+    uint64_t x;
+    asm volatile("rdtime %0" : "=r"(x));
+    return x;
+}
+
+static inline uint64_t r_mcycle(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mcycle" : "=r"(x));
+    return x;
+}
+
+static inline void intr_off(void) {
+    w_mstatus(r_mstatus() & ~MSTATUS_MIE);
+}
+
+static inline void intr_on(void) {
+    w_mstatus(r_mstatus() | MSTATUS_MIE);
+}
+
+#endif
@@ -2,6 +2,11 @@
 #include "fs.h"
 #include "console.h"
 #include "string.h"
+#include "trace.h"
+#include "prof.h"
+#include "fsstress.h"
+#include "param.h"
+#include "task.h"
 
 // Helper: Print file entry for ls command
 static void print_file_entry(const char *name, file_type_t type, uint32_t size) {
@@ -92,12 +97,23 @@ void shell_cat(const char *args) {
         return;
     }
     
-    const char *data = fs_get_data(idx);
-    uint32_t size = fs_get_size(idx);
+    char data[MAX_FILE_SIZE];
+    int size = fs_read(args, data, sizeof(data));
+    if (size < 0) {
+        console_puts("Failed to read: ");
+        console_puts(args);
+        console_putc('\n');
+        return;
+    }
     
-    for (uint32_t i = 0; i < size; i++) {
+    // Byte by byte, as files may hold NULs; yield per line like puts does
+    for (int i = 0; i < size; i++) {
         console_putc(data[i]);
+        if (data[i] == '\n') {
+            task_yield();
+        }
     }
+    task_yield();
 }
 
 // touch - Create empty file
@@ -316,6 +332,361 @@ void shell_echo(const char *args) {
     }
 }
 
+// Helper: Map a trace category name to its mask bit (0 if unknown)
+static uint32_t trace_category(const char *name) {
+    if (strcmp(name, "fs") == 0) return TRACE_FS;
+    if (strcmp(name, "cmd") == 0) return TRACE_CMD;
+    if (strcmp(name, "cons") == 0) return TRACE_CONS;
+    if (strcmp(name, "all") == 0) return TRACE_ALL;
+    return 0;
+}
+
+// trace - Control tracepoints and dump the trace buffers
+// Usage: trace                      (status)
+//        trace on|off [fs|cmd|cons|all ...]
+//        trace clear
+//        trace dump
+void shell_trace(const char *args) {
+    char action[64];
+    char rest[256];
+
+    parse_args(args, action, rest);
+
+    if (action[0] == '\0') {
+        trace_status();
+    } else if (strcmp(action, "on") == 0 || strcmp(action, "off") == 0) {
+        uint32_t cats = 0;
+        char name[64];
+        char tail[256];
+
+        if (rest[0] == '\0') {
+            cats = TRACE_ALL;
+        }
+        while (rest[0] != '\0') {
+            parse_args(rest, name, tail);
+            uint32_t cat = trace_category(name);
+            if (cat == 0) {
+                console_puts("Unknown trace category: ");
+                console_puts(name);
+                console_putc('\n');
+                return;
+            }
+            cats |= cat;
+            strcpy(rest, tail);
+        }
+
+        if (action[1] == 'n') {
+            trace_enable(cats);
+        } else {
+            trace_disable(cats);
+        }
+        trace_status();
+    } else if (strcmp(action, "clear") == 0) {
+        trace_clear();
+    } else if (strcmp(action, "dump") == 0) {
+        trace_dump();
+    } else {
+        console_puts("Usage: trace [on|off [fs|cmd|cons|all]] | clear | dump\n");
+    }
+}
+
+// prof - Timer-driven PC sampling profiler
+// Usage: prof start [hz]
+//        prof stop
+//        prof dump
+void shell_prof(const char *args) {
+    char action[64];
+    char rest[256];
+
+    parse_args(args, action, rest);
+
+    if (strcmp(action, "start") == 0) {
+        uint32_t hz = 0;
+        for (int i = 0; rest[i] >= '0' && rest[i] <= '9' && hz <= PROF_MAX_HZ; i++) {
+            hz = hz * 10 + (rest[i] - '0');
+        }
+        if (rest[0] == '\0') {
+            hz = PROF_DEFAULT_HZ;
+        }
+        if (prof_start(hz) < 0) {
+            console_puts("Usage: prof start [hz], hz from 1 to ");
+            console_putdec(PROF_MAX_HZ);
+            console_putc('\n');
+        }
+    } else if (strcmp(action, "stop") == 0) {
+        prof_stop();
+    } else if (strcmp(action, "dump") == 0) {
+        prof_dump();
+    } else {
+        console_puts("Usage: prof start [hz] | stop | dump\n");
+    }
+}
+
+// cp - Copy a file, or a directory tree with -r
+// Usage: cp [-r] <src> <dst>
+void shell_cp(const char *args) {
+    char src[64];
+    char rest[256];
+    char dst[64];
+    char extra[256];
+    int recursive = 0;
+
+    parse_args(args, src, rest);
+    if (strcmp(src, "-r") == 0) {
+        recursive = 1;
+        strcpy(extra, rest);
+        parse_args(extra, src, rest);
+    }
+    parse_args(rest, dst, extra);
+
+    if (src[0] == '\0' || dst[0] == '\0') {
+        console_puts("Usage: cp [-r] <src> <dst>\n");
+        return;
+    }
+
+    int idx = fs_find(src);
+    if (idx < 0) {
+        console_puts("Not found: ");
+        console_puts(src);
+        console_putc('\n');
+        return;
+    }
+    if (fs_get_type(idx) == TYPE_DIR && !recursive) {
+        console_puts("Is a directory (use cp -r): ");
+        console_puts(src);
+        console_putc('\n');
+        return;
+    }
+
+    if (fs_copy(src, dst, recursive) < 0) {
+        console_puts("Failed to copy to: ");
+        console_puts(dst);
+        console_puts(" (exists, no space, or copy into itself)\n");
+    }
+}
+
+// dedup - Merge identical data blocks across files
+void shell_dedup(const char *args) {
+    int freed = fs_dedup();
+    console_puts("dedup: freed ");
+    console_putdec(freed);
+    console_puts(" blocks\n");
+}
+
+// compress - Set a file's compression mode (or the default for new files)
+// Usage: compress <file> on|off|auto
+//        compress default on|off|auto
+void shell_compress(const char *args) {
+    char target[64];
+    char mode_name[256];
+    int mode;
+
+    parse_args(args, target, mode_name);
+
+    if (strcmp(mode_name, "on") == 0) {
+        mode = FS_COMPRESS_ON;
+    } else if (strcmp(mode_name, "off") == 0) {
+        mode = FS_COMPRESS_OFF;
+    } else if (strcmp(mode_name, "auto") == 0) {
+        mode = FS_COMPRESS_AUTO;
+    } else {
+        console_puts("Usage: compress <file>|default on|off|auto\n");
+        return;
+    }
+
+    if (strcmp(target, "default") == 0) {
+        fs_set_default_compress(mode);
+    } else if (fs_set_compress(target, mode) < 0) {
+        console_puts("Failed to set compression: ");
+        console_puts(target);
+        console_putc('\n');
+    }
+}
+
+// Helper: Print n/d as a percentage with one decimal
+static void print_percent(uint64_t n, uint64_t d) {
+    uint64_t pm = d ? n * 1000 / d : 0;
+    console_putdec(pm / 10);
+    console_putc('.');
+    console_putc('0' + pm % 10);
+    console_putc('%');
+}
+
+// fsstat - Show space usage, compression ratio and codec cost
+void shell_fsstat(const char *args) {
+    fs_stats_t st;
+    fs_get_stats(&st);
+
+    console_puts("files: ");
+    console_putdec(st.files);
+    console_puts(" (");
+    console_putdec(st.packed_files);
+    console_puts(" compressed)\n");
+
+    console_puts("data: ");
+    console_putdec(st.logical_bytes);
+    console_puts(" bytes in ");
+    console_putdec(st.stored_bytes);
+    console_puts(" stored (");
+    print_percent(st.stored_bytes, st.logical_bytes);
+    console_puts(")\n");
+
+    console_puts("compressed files: ");
+    console_putdec(st.packed_logical);
+    console_puts(" -> ");
+    console_putdec(st.packed_stored);
+    console_puts(" bytes (");
+    print_percent(st.packed_stored, st.packed_logical);
+    console_puts(")\n");
+
+    console_puts("blocks: ");
+    console_putdec(st.blocks_used);
+    console_putc('/');
+    console_putdec(NBLOCKS);
+    console_puts(" used, ");
+    console_putdec(BLOCK_SIZE);
+    console_puts(" bytes each\n");
+
+    console_puts("sharing: ");
+    console_putdec(st.blocks_shared);
+    console_puts(" shared blocks, ");
+    console_putdec(st.block_refs - st.blocks_used);
+    console_puts(" blocks saved\n");
+
+    console_puts("compress: ");
+    console_putdec(st.z_bytes);
+    console_puts(" bytes, ");
+    console_putdec(st.z_bytes ? st.z_cycles / st.z_bytes : 0);
+    console_puts(" cycles/byte\n");
+    console_puts("decompress: ");
+    console_putdec(st.unz_bytes);
+    console_puts(" bytes, ");
+    console_putdec(st.unz_bytes ? st.unz_cycles / st.unz_bytes : 0);
+    console_puts(" cycles/byte\n");
+}
+
+// Helper: Parse a decimal argument, or def if it is missing
+static int parse_num(const char *s, int def) {
+    if (s[0] < '0' || s[0] > '9') {
+        return def;
+    }
+    int n = 0;
+    for (int i = 0; s[i] >= '0' && s[i] <= '9'; i++) {
+        n = n * 10 + (s[i] - '0');
+    }
+    return n;
+}
+
+// fsstress - Concurrent create/write/read/delete workers on all harts,
+// then an invariant check
+// Usage: fsstress [workers] [rounds]
+void shell_fsstress(const char *args) {
+    char first[64];
+    char rest[256];
+    struct fsstress_result res;
+
+    parse_args(args, first, rest);
+    int workers = parse_num(first, NCPU);
+    int rounds = parse_num(rest, 200);
+
+    if (fsstress_run(workers, rounds, &res) < 0) {
+        console_puts("fsstress: cannot create the test directory\n");
+        return;
+    }
+    console_puts("fsstress harts=");
+    console_putdec(res.harts);
+    console_puts(" ops=");
+    console_putdec(res.ops);
+    console_puts(" errors=");
+    console_putdec(res.errors);
+    console_puts(" shared_creates=");
+    console_putdec(res.shared);
+    console_puts(" leftover=");
+    console_putdec(res.leftover);
+    console_puts(" leaked_blocks=");
+    console_putdec(res.leaked);
+    console_puts(" cycles=");
+    console_putdec(res.cycles);
+    console_putc('\n');
+    if (res.errors || res.leftover || res.leaked || res.check < 0) {
+        console_puts(res.check < 0 ? "fsstress: FAILED (fs_check)\n" : "fsstress: FAILED\n");
+    } else {
+        console_puts("fsstress: ok\n");
+    }
+}
+
+// Helper: Job named by args, or the highest-numbered one if args is
+// empty; -1 if there is no such job
+static int job_arg(const char *args) {
+    if (args[0] != '\0') {
+        int id = parse_num(args, -1);
+        return (id > 0 && task_state(id) != TASK_FREE) ? id : -1;
+    }
+    for (int id = NTASK - 1; id > 0; id--) {
+        if (task_state(id) != TASK_FREE) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Helper: Print a job's status line, and free its slot if it has finished
+static void report_job(int id) {
+    console_putc('[');
+    console_putdec(id);
+    console_puts(task_state(id) == TASK_DONE ? "] Done     " : "] Running  ");
+    console_puts(task_arg(id));
+    console_putc('\n');
+    task_reap(id);
+}
+
+// jobs - List background jobs. Finished jobs have already announced
+// themselves and freed their slot.
+void shell_jobs(const char *args) {
+    for (int id = 1; id < NTASK; id++) {
+        if (task_state(id) != TASK_FREE) {
+            report_job(id);
+        }
+    }
+}
+
+// fg - Bring a job to the foreground and wait for it
+// Usage: fg [job]
+void shell_fg(const char *args) {
+    int id = job_arg(args);
+    if (id < 0 || id == task_current()) {
+        console_puts("fg: no such job\n");
+        return;
+    }
+    
+    console_puts(task_arg(id));
+    console_putc('\n');
+    task_set_foreground(id);
+    while (task_state(id) == TASK_RUNNABLE) {
+        task_yield();
+    }
+    task_reap(id);
+}
+
+// wait - Wait for a job, or for all jobs, to finish. Their output keeps
+// appearing tagged with the job number meanwhile.
+// Usage: wait [job]
+void shell_wait(const char *args) {
+    int id = args[0] ? job_arg(args) : 0;
+    if (id < 0) {
+        console_puts("wait: no such job\n");
+        return;
+    }
+    
+    for (int j = 1; j < NTASK; j++) {
+        if ((id != 0 && j != id) || j == task_current()) continue;
+        while (task_state(j) == TASK_RUNNABLE) {
+            task_yield();
+        }
+        task_reap(j);
+    }
+}
+
 // sh - Execute shell script
 void shell_sh(const char *args) {
     if (args[0] == '\0') {
@@ -338,14 +709,20 @@ void shell_sh(const char *args) {
         return;
     }
     
-    const char *script = fs_get_data(idx);
-    uint32_t size = fs_get_size(idx);
+    char script[MAX_FILE_SIZE];
+    int size = fs_read(args, script, sizeof(script));
+    if (size < 0) {
+        console_puts("Failed to read: ");
+        console_puts(args);
+        console_putc('\n');
+        return;
+    }
     
     // Execute line by line
     char line[128];
     int line_idx = 0;
     
-    for (uint32_t i = 0; i < size; i++) {
+    for (int i = 0; i < size; i++) {
         if (script[i] == '\n') {
             line[line_idx] = '\0';
             
@@ -375,6 +752,9 @@ void shell_sh(const char *args) {
                     console_puts(cmd);
                     console_putc('\n');
                 }
+                
+                // Let other jobs run between script lines
+                task_yield();
             }
             
             line_idx = 0;
@@ -12,5 +12,15 @@ void shell_pwd(void);
 void shell_rm(const char *args);
 void shell_write(const char *args);
 void shell_echo(const char *args);
+void shell_trace(const char *args);
+void shell_prof(const char *args);
+void shell_cp(const char *args);
+void shell_dedup(const char *args);
+void shell_compress(const char *args);
+void shell_fsstat(const char *args);
+void shell_fsstress(const char *args);
+void shell_jobs(const char *args);
+void shell_fg(const char *args);
+void shell_wait(const char *args);
 
 #endif
@@ -0,0 +1,53 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+
+// Test-and-set spinlock. Only compiler builtins, so fs.c keeps building
+// on the host. Nothing that takes these runs from the trap handler, so
+// interrupts stay as they are.
+struct spinlock {
+    volatile uint32_t locked;
+};
+
+static inline void initlock(struct spinlock *lk) {
+    __atomic_store_n(&lk->locked, 0, __ATOMIC_RELAXED);
+}
+
+static inline void acquire(struct spinlock *lk) {
+    while (__atomic_exchange_n(&lk->locked, 1, __ATOMIC_ACQUIRE)) {
+        // Spin on plain loads so waiters do not bounce the cache line
+        while (__atomic_load_n(&lk->locked, __ATOMIC_RELAXED))
+            ;
+    }
+}
+
+static inline void release(struct spinlock *lk) {
+    __atomic_store_n(&lk->locked, 0, __ATOMIC_RELEASE);
+}
+
+// Sequence counter: writers (serialized by some lock) make it odd while
+// they change the data it covers; readers retry if it moved.
+static inline void seq_write_begin(volatile uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seq_write_end(volatile uint32_t *seq) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t seq_read_begin(volatile uint32_t *seq) {
+    uint32_t s;
+    while ((s = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1)
+        ;
+    return s;
+}
+
+static inline int seq_read_retry(volatile uint32_t *seq, uint32_t s) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != s;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include "task.h"
+#include "riscv.h"
+#include "console.h"
+#include "string.h"
+
+// Registers saved by swtch()
+struct task_context {
+    uint64_t ra;
+    uint64_t sp;
+    uint64_t s[12];
+};
+
+struct task {
+    int state;
+    struct task_context ctx;
+    void (*fn)(const char *arg);
+    char arg[TASK_ARG];
+    fs_context_t fs;          // Each task has its own working directory
+    char line[CONSOLE_LINE];  // Background output not yet printed
+    int line_len;
+};
+
+extern void swtch(struct task_context *old, struct task_context *new);  // swtch.s
+
+static struct task tasks[NTASK];
+static int current;   // Index of the running task
+static int fg;        // Foreground task
+
+// Job stacks are not zeroed at boot, like the boot stack
+static char stacks[NTASK][TASK_STACK] __attribute__((section(".stack.tasks"), aligned(16)));
+
+// Written at the bottom of each job's stack; a job that overflows its
+// stack tramples it before it reaches the stack below
+#define STACK_CANARY 0x5354434b43414e59UL
+
+// Helper: Stop the machine if the running job has overflowed its stack
+static void check_stack(void) {
+    if (current == 0 || *(uint64_t *)stacks[current] == STACK_CANARY) {
+        return;
+    }
+    task_set_foreground(current);  // Emits its partial line
+    console_panic();
+    console_puts("\ntask ");
+    console_putdec(current);
+    console_puts(": stack overflow\nhalted.\n");
+    console_flush();
+    intr_off();
+    while (1) {
+        asm volatile("wfi");
+    }
+}
+
+// Task 0 is whoever calls this: the shell loop in main()
+void task_init(void) {
+    tasks[0].state = TASK_RUNNABLE;
+    current = 0;
+    fg = 0;
+}
+
+// Helper: Print a background task's pending line
+static void flush_line(struct task *t) {
+    if (t->line_len > 0) {
+        console_emit_line(t - tasks, t->line, t->line_len);
+        t->line_len = 0;
+    }
+}
+
+// Helper: Finish the running task and switch away for good. A foreground
+// job stays TASK_DONE until fg/wait reaps it; a background job announces
+// itself and frees its slot at once. Freeing it while still on its stack
+// is safe: only another task can call task_spawn, and this one never
+// runs again after the switch.
+static void task_exit(void) {
+    struct task *t = &tasks[current];
+
+    check_stack();
+    fs_set_cwd(0);  // Drop the pin on the working directory
+    flush_line(t);
+    if (fg == current) {
+        fg = 0;
+        t->state = TASK_DONE;
+    } else {
+        char msg[TASK_ARG + 8];
+        strcpy(msg, "Done    ");
+        strncpy(msg + 8, t->arg, TASK_ARG - 1);
+        msg[TASK_ARG + 7] = '\0';
+        console_emit_line(current, msg, strlen(msg));
+        t->state = TASK_FREE;
+    }
+    task_yield();
+}
+
+// First code a new task runs, entered from swtch() on its own stack
+static void task_start(void) {
+    struct task *t = &tasks[current];
+    t->fn(t->arg);
+    task_exit();
+}
+
+// Start fn(arg) as a background task. arg is copied.
+int task_spawn(void (*fn)(const char *arg), const char *arg) {
+    int cwd = fs_get_cwd();
+
+    for (int i = 1; i < NTASK; i++) {
+        struct task *t = &tasks[i];
+        if (t->state != TASK_FREE) continue;
+
+        t->fn = fn;
+        strncpy(t->arg, arg, TASK_ARG - 1);
+        t->arg[TASK_ARG - 1] = '\0';
+        t->line_len = 0;
+        t->fs.cwd = 0;
+        for (int k = 0; k < 12; k++) t->ctx.s[k] = 0;
+        t->ctx.ra = (uint64_t)task_start;
+        t->ctx.sp = (uint64_t)(stacks[i] + TASK_STACK);
+        *(uint64_t *)stacks[i] = STACK_CANARY;
+        t->state = TASK_RUNNABLE;
+
+        // Inherit the working directory, pinned for the job's lifetime
+        int saved = current;
+        current = i;
+        fs_set_cwd(cwd);
+        current = saved;
+        return i;
+    }
+    return -1; // No free task slots
+}
+
+// Switch to the next runnable task, round robin. Only hart 0 runs tasks;
+// elsewhere (and before task_init) this returns at once.
+void task_yield(void) {
+    if (r_mhartid() != 0 || tasks[0].state != TASK_RUNNABLE) {
+        return;
+    }
+    check_stack();
+    int prev = current;
+    int next = prev;
+    do {
+        next = (next + 1) % NTASK;
+    } while (tasks[next].state != TASK_RUNNABLE && next != prev);
+    if (next == prev) {
+        return;
+    }
+    current = next;
+    swtch(&tasks[prev].ctx, &tasks[next].ctx);
+}
+
+int task_current(void) {
+    return current;
+}
+
+int task_state(int id) {
+    return (id >= 0 && id < NTASK) ? tasks[id].state : TASK_FREE;
+}
+
+const char *task_arg(int id) {
+    return tasks[id].arg;
+}
+
+// Release a finished task's slot
+void task_reap(int id) {
+    if (id > 0 && id < NTASK && tasks[id].state == TASK_DONE) {
+        tasks[id].state = TASK_FREE;
+    }
+}
+
+int task_foreground(void) {
+    return fg;
+}
+
+void task_set_foreground(int id) {
+    if (id >= 0 && id < NTASK && tasks[id].state == TASK_RUNNABLE) {
+        flush_line(&tasks[id]);
+        fg = id;
+    }
+}
+
+// Called by the console for every character written. Background tasks
+// collect whole lines so that concurrent jobs never interleave mid-line.
+int task_output(char c) {
+    if (r_mhartid() != 0 || current == fg) {
+        return 0;
+    }
+    struct task *t = &tasks[current];
+    if (c == '\n') {
+        console_emit_line(current, t->line, t->line_len);
+        t->line_len = 0;
+        return 1;
+    }
+    t->line[t->line_len++] = c;
+    if (t->line_len == CONSOLE_LINE) {
+        flush_line(t);
+    }
+    return 1;
+}
+
+fs_context_t *task_fs_context(void) {
+    return &tasks[current].fs;
+}
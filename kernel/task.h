@@ -0,0 +1,36 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "types.h"
+#include "fs.h"
+
+// Cooperative tasks on hart 0. Task 0 is the shell loop running on the
+// boot stack; the others are jobs with stacks of their own. A task runs
+// until it yields, which console I/O and scripts do regularly.
+#define NTASK       8
+#define TASK_STACK  8192
+#define TASK_ARG    128   // Command line a job was started with
+
+enum task_state {
+    TASK_FREE,
+    TASK_RUNNABLE,
+    TASK_DONE,            // Exited in the foreground, waiting for fg/wait
+};
+
+void task_init(void);
+int task_spawn(void (*fn)(const char *arg), const char *arg);  // id or -1
+void task_yield(void);
+int task_current(void);
+int task_state(int id);
+const char *task_arg(int id);
+void task_reap(int id);
+
+// The foreground task writes to the console directly and owns input;
+// output from the others is collected into lines tagged "[id] ".
+int task_foreground(void);
+void task_set_foreground(int id);
+int task_output(char c);          // 1 if c was taken as background output
+
+fs_context_t *task_fs_context(void);
+
+#endif
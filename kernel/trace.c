@@ -0,0 +1,140 @@
+#include "trace.h"
+#include "param.h"
+#include "riscv.h"
+#include "console.h"
+#include "task.h"
+
+// One ring per hart. Only the owning hart writes its ring, so recording
+// needs no locks: fill the slot, then publish it by bumping head.
+struct trace_ring {
+    volatile uint64_t head;   // total entries ever recorded
+    struct trace_entry ent[TRACE_ENTRIES];
+};
+
+volatile uint32_t trace_mask;
+static struct trace_ring rings[NCPU];
+
+// The dump goes through traced console I/O and may yield to other jobs,
+// so only the dumping task (on hart 0) stops recording while it runs.
+// Both live in .bss, so a warm reboot starts with no dump in progress.
+static int dumping;
+static int dump_task;
+
+static const char *trace_event_names[TEV_NEVENTS] = {
+    "none", "fs_find", "fs_create", "fs_write", "fs_append", "fs_delete",
+    "cmd", "cons_puts", "cons_getc"
+};
+
+void trace_record(uint32_t event, uint32_t phase, uint32_t arg0, uint64_t arg1) {
+    uint64_t hart = r_mhartid();
+    if (hart >= NCPU) {
+        return;
+    }
+    if (hart == 0 && dumping && task_current() == dump_task) {
+        return;
+    }
+
+    struct trace_ring *r = &rings[hart];
+    uint64_t h = r->head;
+    struct trace_entry *e = &r->ent[h & (TRACE_ENTRIES - 1)];
+
+    e->ts = r_time();
+    e->event = event;
+    e->phase = phase;
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+void trace_enable(uint32_t cats) {
+    trace_mask |= cats;
+}
+
+void trace_disable(uint32_t cats) {
+    trace_mask &= ~cats;
+}
+
+void trace_clear(void) {
+    for (int i = 0; i < NCPU; i++) {
+        rings[i].head = 0;
+    }
+}
+
+void trace_status(void) {
+    console_puts("trace: fs=");
+    console_puts((trace_mask & TRACE_FS) ? "on" : "off");
+    console_puts(" cmd=");
+    console_puts((trace_mask & TRACE_CMD) ? "on" : "off");
+    console_puts(" cons=");
+    console_puts((trace_mask & TRACE_CONS) ? "on" : "off");
+    console_putc('\n');
+    for (int i = 0; i < NCPU; i++) {
+        if (rings[i].head == 0) continue;
+        console_puts("  hart ");
+        console_putdec(i);
+        console_puts(": ");
+        console_putdec(rings[i].head);
+        console_puts(" events\n");
+    }
+}
+
+// Dump every ring, oldest entry first, as one line per event:
+//   T <hart> <ts> <event> <phase> <arg0> <arg1>   (numbers in hex)
+// tools/trace2flame.py turns this into folded stacks or a timeline.
+void trace_dump(void) {
+    if (dumping) {
+        console_puts("trace: a dump is already running\n");
+        return;
+    }
+    dump_task = task_current();
+    dumping = 1;
+
+    console_puts("# trace begin hz=");
+    console_putdec(TIMEBASE_HZ);
+    console_putc('\n');
+    for (int ev = 1; ev < TEV_NEVENTS; ev++) {
+        console_puts("# event ");
+        console_putdec(ev);
+        console_putc(' ');
+        console_puts(trace_event_names[ev]);
+        console_putc('\n');
+    }
+
+    for (int i = 0; i < NCPU; i++) {
+        uint64_t head = __atomic_load_n(&rings[i].head, __ATOMIC_ACQUIRE);
+        uint64_t start = head > TRACE_ENTRIES ? head - TRACE_ENTRIES : 0;
+        if (start > 0) {
+            console_puts("# hart ");
+            console_putdec(i);
+            console_puts(" dropped ");
+            console_putdec(start);
+            console_putc('\n');
+        }
+        for (uint64_t n = start; n < head; n++) {
+            // Recording goes on while the dump yields; skip entries whose
+            // slot has been reused (or is being reused) since head was read
+            struct trace_entry copy = rings[i].ent[n & (TRACE_ENTRIES - 1)];
+            __sync_synchronize();   // the copy before the head it is checked against
+            if (__atomic_load_n(&rings[i].head, __ATOMIC_ACQUIRE) - n >= TRACE_ENTRIES) {
+                continue;
+            }
+            struct trace_entry *e = &copy;
+            console_puts("T ");
+            console_putx(i);
+            console_putc(' ');
+            console_putx(e->ts);
+            console_putc(' ');
+            console_putx(e->event);
+            console_putc(' ');
+            console_putc("BEI"[e->phase < 3 ? e->phase : 2]);
+            console_putc(' ');
+            console_putx(e->arg0);
+            console_putc(' ');
+            console_putx(e->arg1);
+            console_putc('\n');
+        }
+    }
+    console_puts("# trace end\n");
+
+    dumping = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+// Tracepoint categories (bits of trace_mask)
+#define TRACE_FS    (1u << 0)   // filesystem API
+#define TRACE_CMD   (1u << 1)   // shell command dispatch
+#define TRACE_CONS  (1u << 2)   // console I/O
+#define TRACE_ALL   (TRACE_FS | TRACE_CMD | TRACE_CONS)
+
+// Event ids; keep trace_event_names[] in trace.c in sync
+enum trace_event {
+    TEV_NONE,
+    TEV_FS_FIND,
+    TEV_FS_CREATE,
+    TEV_FS_WRITE,
+    TEV_FS_APPEND,
+    TEV_FS_DELETE,
+    TEV_CMD,
+    TEV_CONS_PUTS,
+    TEV_CONS_GETC,
+    TEV_NEVENTS
+};
+
+// Event phases
+#define TRACE_BEGIN   0
+#define TRACE_END     1
+#define TRACE_INSTANT 2
+
+#define TRACE_ENTRIES 1024  // per hart, power of two
+
+struct trace_entry {
+    uint64_t ts;       // rdtime at the tracepoint
+    uint16_t event;
+    uint16_t phase;
+    uint32_t arg0;
+    uint64_t arg1;
+};
+
+extern volatile uint32_t trace_mask;
+
+void trace_record(uint32_t event, uint32_t phase, uint32_t arg0, uint64_t arg1);
+void trace_enable(uint32_t cats);
+void trace_disable(uint32_t cats);
+void trace_clear(void);
+void trace_status(void);
+void trace_dump(void);
+
+// Tracepoint: a single load and a not-taken branch while the category is off
+#define TRACE(cat, ev, ph, a0, a1)                                   \
+    do {                                                             \
+        if (__builtin_expect(trace_mask & (cat), 0))                 \
+            trace_record((ev), (ph), (uint32_t)(a0), (uint64_t)(a1)); \
+    } while (0)
+
+// Pack the first 8 bytes of a string into a trace argument
+static inline uint64_t trace_tag(const char *s) {
+    uint64_t tag = 0;
+    for (int i = 0; i < 8 && s[i]; i++) {
+        tag |= (uint64_t)(uint8_t)s[i] << (8 * i);
+    }
+    return tag;
+}
+
+#endif
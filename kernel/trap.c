@@ -0,0 +1,46 @@
+#include "trap.h"
+#include "riscv.h"
+#include "console.h"
+#include "prof.h"
+#include "task.h"
+
+extern void trap_vector(void); // from entry.S
+
+// Point mtvec at the assembly trap vector (direct mode)
+void trap_init(void) {
+    w_mtvec((uint64_t)trap_vector);
+}
+
+// Called from trap_vector with caller-saved registers on the stack
+void kernel_trap(void) {
+    uint64_t cause = r_mcause();
+
+    if (cause & MCAUSE_INTR) {
+        if ((cause & ~MCAUSE_INTR) == MCAUSE_MTI) {
+            // The machine timer only drives the sampling profiler
+            prof_tick(r_mepc());
+        }
+        return;
+    }
+
+    // Synchronous exception: nothing can be recovered, report and stop.
+    // The report goes straight to the console, even from a background
+    // job, without switching tasks. Task state belongs to hart 0.
+    if (r_mhartid() == 0) {
+        task_set_foreground(task_current());  // Emits its partial line
+        console_panic();
+    }
+    console_puts("\nkernel trap: mcause=");
+    console_puthex(cause);
+    console_puts(" mepc=");
+    console_puthex(r_mepc());
+    console_puts(" mtval=");
+    console_puthex(r_mtval());
+    console_puts("\nhalted.\n");
+    console_flush();
+
+    intr_off();
+    while (1) {
+        asm volatile("wfi");
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef TRAP_H
+#define TRAP_H
+
+// Machine-mode trap handling
+void trap_init(void);
+void kernel_trap(void);
+
+#endif
@@ -6,11 +6,13 @@ typedef unsigned short uint16_t;
 typedef unsigned int   uint32_t;
 typedef unsigned long  uint64_t;
 
-typedef char  int8_t;
+typedef signed char int8_t;
 typedef short int16_t;
 typedef int   int32_t;
 typedef long  int64_t;
 
+#ifndef NULL
 #define NULL ((void*)0)
+#endif
 
 #endif
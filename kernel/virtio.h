@@ -0,0 +1,61 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include "types.h"
+
+// virtio-mmio device registers (version 2, "modern"), from the virtio
+// 1.1 spec. QEMU needs -global virtio-mmio.force-legacy=false for these.
+#define VIRTIO_MMIO_MAGIC_VALUE         0x000  // 0x74726976 ("virt")
+#define VIRTIO_MMIO_VERSION             0x004  // 2
+#define VIRTIO_MMIO_DEVICE_ID           0x008  // 0 = empty slot, 3 = console
+#define VIRTIO_MMIO_VENDOR_ID           0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES     0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL 0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES     0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL 0x024
+#define VIRTIO_MMIO_QUEUE_SEL           0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX       0x034
+#define VIRTIO_MMIO_QUEUE_NUM           0x038
+#define VIRTIO_MMIO_QUEUE_READY         0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY        0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS    0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK       0x064
+#define VIRTIO_MMIO_STATUS              0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW      0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH     0x084
+#define VIRTIO_MMIO_DRIVER_DESC_LOW     0x090  // available ring
+#define VIRTIO_MMIO_DRIVER_DESC_HIGH    0x094
+#define VIRTIO_MMIO_DEVICE_DESC_LOW     0x0a0  // used ring
+#define VIRTIO_MMIO_DEVICE_DESC_HIGH    0x0a4
+
+#define VIRTIO_MAGIC      0x74726976
+#define VIRTIO_ID_CONSOLE 3
+
+// Status register bits
+#define VIRTIO_STATUS_ACKNOWLEDGE 1
+#define VIRTIO_STATUS_DRIVER      2
+#define VIRTIO_STATUS_DRIVER_OK   4
+#define VIRTIO_STATUS_FEATURES_OK 8
+
+// Feature bits in the second 32-bit feature word
+#define VIRTIO_F_VERSION_1_HI (1 << (32 - 32))
+
+// Split virtqueue layout
+struct virtq_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+#define VRING_DESC_F_NEXT  1   // chained with another descriptor
+#define VRING_DESC_F_WRITE 2   // device writes (vs. reads) the buffer
+
+#define VRING_AVAIL_F_NO_INTERRUPT 1   // driver polls; no used-buffer interrupts
+#define VRING_USED_F_NO_NOTIFY     1   // device does not need QUEUE_NOTIFY now
+
+struct virtq_used_elem {
+    uint32_t id;    // head of the completed descriptor chain
+    uint32_t len;   // bytes written into it
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "virtio_console.h"
+#include "virtio.h"
+#include "memlayout.h"
+#include "riscv.h"
+
+// Polled driver for port 0 of a virtio-console on the virtio-mmio bus.
+// Each queue has VQ_NUM single-descriptor buffers, permanently paired
+// with descriptor i. The kernel has no PLIC, so used-buffer interrupts
+// are suppressed and both rings are polled.
+//
+// Output is packed into TX_BUF-byte buffers and the device is only
+// notified once TX_BATCH buffers are queued, when every buffer is in
+// flight, or on virtcons_flush(). Input buffers are handed back to the
+// device RX_BATCH at a time, or at once if the device has run dry.
+
+#define VQ_NUM    8
+#define TX_BUF    512
+#define RX_BUF    256
+#define TX_BATCH  4
+#define RX_BATCH  (VQ_NUM / 2)
+#define TX_DELAY  (TIMEBASE_HZ / 100)   // flush a partial buffer at '\n' after 10 ms
+
+#define RXQ 0   // port 0 receiveq
+#define TXQ 1   // port 0 transmitq
+
+struct virtq_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[VQ_NUM];
+};
+
+struct virtq_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct virtq_used_elem ring[VQ_NUM];
+};
+
+struct vq {
+    struct virtq_desc desc[VQ_NUM] __attribute__((aligned(16)));
+    struct virtq_avail avail __attribute__((aligned(2)));
+    struct virtq_used used __attribute__((aligned(4)));
+    uint16_t used_seen;   // used ring entries consumed so far
+    uint16_t unkicked;    // buffers made available since the last notify
+};
+
+static struct vq rxq, txq;
+static char rx_bufs[VQ_NUM][RX_BUF];
+static char tx_bufs[VQ_NUM][TX_BUF];
+
+static uint64_t base;   // MMIO base of the device, 0 if none
+
+static int tx_free[VQ_NUM];   // stack of idle transmit buffers
+static int tx_nfree;
+static int tx_cur;            // buffer being filled, -1 if none
+static uint32_t tx_len;
+static uint64_t tx_since;     // when tx_cur got its first byte
+
+static int rx_cur;            // buffer being drained, -1 if none
+static uint32_t rx_len, rx_pos;
+
+static struct virtcons_stats stats;
+
+static inline uint32_t reg_read(uint32_t off) {
+    return *(volatile uint32_t *)(base + off);
+}
+
+static inline void reg_write(uint32_t off, uint32_t val) {
+    *(volatile uint32_t *)(base + off) = val;
+}
+
+// Helper: Find a version 2 virtio-console among the virtio-mmio slots
+static uint64_t probe(void) {
+    for (int i = 0; i < VIRTIO_MMIO_SLOTS; i++) {
+        volatile uint32_t *dev = (volatile uint32_t *)(VIRTIO0 + i * VIRTIO_MMIO_STRIDE);
+        if (dev[VIRTIO_MMIO_MAGIC_VALUE / 4] == VIRTIO_MAGIC &&
+            dev[VIRTIO_MMIO_VERSION / 4] == 2 &&
+            dev[VIRTIO_MMIO_DEVICE_ID / 4] == VIRTIO_ID_CONSOLE) {
+            return (uint64_t)dev;
+        }
+    }
+    return 0;
+}
+
+// Helper: Hand a virtqueue's rings to the device
+static int setup_queue(int sel, struct vq *q) {
+    reg_write(VIRTIO_MMIO_QUEUE_SEL, sel);
+    if (reg_read(VIRTIO_MMIO_QUEUE_READY) || reg_read(VIRTIO_MMIO_QUEUE_NUM_MAX) < VQ_NUM) {
+        return -1;
+    }
+    reg_write(VIRTIO_MMIO_QUEUE_NUM, VQ_NUM);
+    reg_write(VIRTIO_MMIO_QUEUE_DESC_LOW, (uint64_t)q->desc);
+    reg_write(VIRTIO_MMIO_QUEUE_DESC_HIGH, (uint64_t)q->desc >> 32);
+    reg_write(VIRTIO_MMIO_DRIVER_DESC_LOW, (uint64_t)&q->avail);
+    reg_write(VIRTIO_MMIO_DRIVER_DESC_HIGH, (uint64_t)&q->avail >> 32);
+    reg_write(VIRTIO_MMIO_DEVICE_DESC_LOW, (uint64_t)&q->used);
+    reg_write(VIRTIO_MMIO_DEVICE_DESC_HIGH, (uint64_t)&q->used >> 32);
+    reg_write(VIRTIO_MMIO_QUEUE_READY, 1);
+    return 0;
+}
+
+// Helper: Make buffer id available to the device, without notifying it
+static void post(struct vq *q, int id) {
+    q->avail.ring[q->avail.idx % VQ_NUM] = id;
+    __sync_synchronize();   // ring entry before index
+    q->avail.idx++;
+    q->unkicked++;
+}
+
+// Helper: Notify the device of everything posted since the last kick
+static void kick(struct vq *q, int sel, uint64_t *count) {
+    if (q->unkicked == 0) {
+        return;
+    }
+    q->unkicked = 0;
+    __sync_synchronize();   // avail index before the flags check and notify
+    if (!(q->used.flags & VRING_USED_F_NO_NOTIFY)) {
+        reg_write(VIRTIO_MMIO_QUEUE_NOTIFY, sel);
+        (*count)++;
+    }
+}
+
+// Helper: Next used ring entry, or 0 if the device has not returned any
+static struct virtq_used_elem *next_used(struct vq *q) {
+    if (q->used_seen == *(volatile uint16_t *)&q->used.idx) {
+        return 0;
+    }
+    __sync_synchronize();   // index before the entry it covers
+    return &q->used.ring[q->used_seen++ % VQ_NUM];
+}
+
+// Helper: Forget all driver-side queue state. A warm reboot clears .bss
+// but does not reload .data, so nothing here relies on an initializer.
+static void reset_state(void) {
+    struct vq *qs[] = { &rxq, &txq };
+    for (int i = 0; i < 2; i++) {
+        qs[i]->avail.idx = 0;
+        qs[i]->used.idx = 0;
+        qs[i]->used_seen = 0;
+        qs[i]->unkicked = 0;
+    }
+    tx_nfree = 0;
+    tx_cur = -1;
+    tx_len = 0;
+    tx_since = 0;
+    rx_cur = -1;
+    rx_len = 0;
+    rx_pos = 0;
+}
+
+int virtcons_init(void) {
+    reset_state();
+    base = probe();
+    if (base == 0) {
+        return -1;
+    }
+
+    // Reset (this also discards queues left over from before a warm reboot)
+    reg_write(VIRTIO_MMIO_STATUS, 0);
+    uint32_t status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+    reg_write(VIRTIO_MMIO_STATUS, status);
+
+    // Only VERSION_1: no multiport, no size/emergency-write config
+    reg_write(VIRTIO_MMIO_DEVICE_FEATURES_SEL, 1);
+    if (!(reg_read(VIRTIO_MMIO_DEVICE_FEATURES) & VIRTIO_F_VERSION_1_HI)) {
+        goto fail;
+    }
+    reg_write(VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+    reg_write(VIRTIO_MMIO_DRIVER_FEATURES, 0);
+    reg_write(VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1);
+    reg_write(VIRTIO_MMIO_DRIVER_FEATURES, VIRTIO_F_VERSION_1_HI);
+    status |= VIRTIO_STATUS_FEATURES_OK;
+    reg_write(VIRTIO_MMIO_STATUS, status);
+    if (!(reg_read(VIRTIO_MMIO_STATUS) & VIRTIO_STATUS_FEATURES_OK)) {
+        goto fail;
+    }
+
+    for (int i = 0; i < VQ_NUM; i++) {
+        rxq.desc[i].addr = (uint64_t)rx_bufs[i];
+        rxq.desc[i].len = RX_BUF;
+        rxq.desc[i].flags = VRING_DESC_F_WRITE;
+        txq.desc[i].addr = (uint64_t)tx_bufs[i];
+        txq.desc[i].flags = 0;
+        tx_free[i] = i;
+    }
+    tx_nfree = VQ_NUM;
+    rxq.avail.flags = VRING_AVAIL_F_NO_INTERRUPT;
+    txq.avail.flags = VRING_AVAIL_F_NO_INTERRUPT;
+    if (setup_queue(RXQ, &rxq) < 0 || setup_queue(TXQ, &txq) < 0) {
+        goto fail;
+    }
+
+    status |= VIRTIO_STATUS_DRIVER_OK;
+    reg_write(VIRTIO_MMIO_STATUS, status);
+
+    // Every receive buffer starts out with the device
+    for (int i = 0; i < VQ_NUM; i++) {
+        post(&rxq, i);
+    }
+    kick(&rxq, RXQ, &stats.rx_kicks);
+    return 0;
+
+fail:
+    reg_write(VIRTIO_MMIO_STATUS, 0);
+    base = 0;
+    return -1;
+}
+
+// Helper: Take back transmit buffers the device has finished with
+static void tx_reclaim(void) {
+    struct virtq_used_elem *e;
+    while ((e = next_used(&txq)) != 0) {
+        tx_free[tx_nfree++] = e->id;
+    }
+}
+
+// Helper: Queue the buffer being filled
+static void tx_post(void) {
+    txq.desc[tx_cur].len = tx_len;
+    post(&txq, tx_cur);
+    stats.tx_bufs++;
+    tx_cur = -1;
+    if (txq.unkicked >= TX_BATCH) {
+        kick(&txq, TXQ, &stats.tx_kicks);
+    }
+}
+
+void virtcons_putc(char c) {
+    if (tx_cur < 0) {
+        tx_reclaim();
+        while (tx_nfree == 0) {
+            // Everything is in flight; make sure the device knows
+            kick(&txq, TXQ, &stats.tx_kicks);
+            tx_reclaim();
+        }
+        tx_cur = tx_free[--tx_nfree];
+        tx_len = 0;
+        tx_since = r_time();
+    }
+    tx_bufs[tx_cur][tx_len++] = c;
+    stats.tx_bytes++;
+    if (tx_len == TX_BUF) {
+        tx_post();
+    } else if (c == '\n' && r_time() - tx_since >= TX_DELAY) {
+        // Long-running output: do not sit on it until the next prompt
+        virtcons_flush();
+    }
+}
+
+void virtcons_flush(void) {
+    if (tx_cur >= 0) {
+        tx_post();
+    }
+    kick(&txq, TXQ, &stats.tx_kicks);
+}
+
+int virtcons_getc(void) {
+    while (1) {
+        if (rx_cur >= 0) {
+            if (rx_pos < rx_len) {
+                stats.rx_bytes++;
+                return (unsigned char)rx_bufs[rx_cur][rx_pos++];
+            }
+            // Drained: give it back, and kick once a batch has built up
+            post(&rxq, rx_cur);
+            rx_cur = -1;
+            if (rxq.unkicked >= RX_BATCH) {
+                kick(&rxq, RXQ, &stats.rx_kicks);
+            }
+        }
+
+        struct virtq_used_elem *e = next_used(&rxq);
+        if (e == 0) {
+            // Nothing waiting; the device may be out of buffers
+            kick(&rxq, RXQ, &stats.rx_kicks);
+            return -1;
+        }
+        rx_cur = e->id;
+        rx_len = e->len < RX_BUF ? e->len : RX_BUF;
+        rx_pos = 0;
+        stats.rx_bufs++;
+    }
+}
+
+void virtcons_get_stats(struct virtcons_stats *st) {
+    *st = stats;
+}
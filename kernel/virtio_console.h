@@ -0,0 +1,22 @@
+#ifndef VIRTIO_CONSOLE_H
+#define VIRTIO_CONSOLE_H
+
+#include "types.h"
+
+// Polled virtio-console driver (port 0 only)
+struct virtcons_stats {
+    uint64_t tx_bytes;
+    uint64_t tx_bufs;     // buffers handed to the device
+    uint64_t tx_kicks;    // QUEUE_NOTIFY writes for the transmit queue
+    uint64_t rx_bytes;
+    uint64_t rx_bufs;
+    uint64_t rx_kicks;
+};
+
+int virtcons_init(void);     // 0 if a virtio-console device was set up
+void virtcons_putc(char c);
+void virtcons_flush(void);
+int virtcons_getc(void);     // next input byte, or -1 if none is waiting
+void virtcons_get_stats(struct virtcons_stats *st);
+
+#endif
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Boot the kernel headless in QEMU, run the benchmark suite, power off.
+# Usage: tools/bench.sh kernel.elf [filter]
+#
+# -icount makes mcycle advance with retired instructions, so cycle
+# counts are repeatable from run to run and across host machines.
+
+KERNEL=${1:-kernel/kernel.elf}
+FILTER=$2
+QEMU=${QEMU:-qemu-system-riscv64}
+
+# QEMU only feeds the UART when the kernel has consumed the previous byte,
+# so both commands can be queued up front.
+printf 'bench %s\npoweroff\n' "$FILTER" |
+    timeout "${BENCH_TIMEOUT:-300}" "$QEMU" -machine virt -bios none \
+        -kernel "$KERNEL" -icount shift=0 \
+        -display none -monitor none -serial stdio |
+    tr -d '\r'
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Compare kernel `bench` output against a stored baseline.
+
+Usage: tools/benchcmp.py BASELINE RESULTS [--tolerance PCT]
+
+Both files hold `bench name=... cycles_per_op=...` lines. A test regresses
+when its cycles_per_op grows by more than the tolerance (default 10%).
+Exits non-zero on any regression, on a test missing from the results,
+when the kernel reported a test that could not run ("bench: ..." lines),
+or when there is no baseline to compare against.
+"""
+
+import argparse
+import os
+import sys
+
+
+def load(path):
+    results = {}
+    for line in open(path, errors="replace"):
+        line = line.strip()
+        if not line.startswith("bench name="):
+            continue
+        fields = dict(f.split("=", 1) for f in line.split()[1:] if "=" in f)
+        results[fields["name"]] = fields
+    return results
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("baseline")
+    ap.add_argument("results")
+    ap.add_argument("--tolerance", type=float, default=10.0)
+    args = ap.parse_args()
+
+    current = load(args.results)
+    if not current:
+        sys.exit("no bench results in " + args.results)
+    errors = [line.strip() for line in open(args.results, errors="replace")
+              if line.startswith("bench: ")]
+    for line in errors:
+        print(line)
+
+    if not os.path.exists(args.baseline):
+        for name, f in current.items():
+            print("%-16s %12s cycles/op" % (name, f["cycles_per_op"]))
+        # Nothing was checked, so this must not pass as a clean run
+        sys.exit("no baseline at %s; run `make bench-baseline` to record one"
+                 % args.baseline)
+
+    baseline = load(args.baseline)
+    failed = bool(errors)
+    print("%-16s %12s %12s %8s" % ("test", "baseline", "current", "change"))
+    for name, base in baseline.items():
+        if name not in current:
+            print("%-16s %12s %12s   MISSING" % (name, base["cycles_per_op"], "-"))
+            failed = True
+            continue
+        old = int(base["cycles_per_op"])
+        new = int(current[name]["cycles_per_op"])
+        change = (new - old) * 100.0 / old if old else 0.0
+        mark = ""
+        if change > args.tolerance:
+            mark = "  REGRESSION"
+            failed = True
+        print("%-16s %12d %12d %+7.1f%%%s" % (name, old, new, change, mark))
+    for name in current:
+        if name not in baseline:
+            print("%-16s %12s %12s   new" % (name, "-", current[name]["cycles_per_op"]))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
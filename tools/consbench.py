@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Measure console throughput over the UART and the virtio-console.
+
+Usage: tools/consbench.py KERNEL [--bytes N] [--file PATH] [--backend NAME]
+
+Boots KERNEL in QEMU once per backend and pipes a large input through
+`consbench rx` (host -> guest), then has `consbench tx` write the same
+amount back (guest -> host). Both directions are checked byte for byte:
+rx by FNV-1a hash, tx against the pattern the kernel generates. Times
+come from the guest's own timer, so no -icount here: I/O costs real time.
+Each run then warm-reboots the guest and pipes a short input through
+again, so the backend is also checked after a restart.
+Exits non-zero if a backend is missing or corrupts data.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import threading
+import time
+
+QEMU = os.environ.get("QEMU", "qemu-system-riscv64")
+TIMEOUT = int(os.environ.get("BENCH_TIMEOUT", "300"))
+CONS_LINE = 64   # matches kernel/bench.c
+PROMPT = "Type 'help' for commands."
+REBOOT_CHECK = 4096   # bytes piped through rx after the warm reboot
+
+BACKENDS = {
+    "uart": ["-serial", "stdio"],
+    # The kernel drives the modern (version 2) virtio-mmio interface
+    "virtio": ["-global", "virtio-mmio.force-legacy=false",
+               "-device", "virtio-serial-device",
+               "-chardev", "stdio,id=cons",
+               "-device", "virtconsole,chardev=cons",
+               "-serial", "none"],
+}
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+
+def tx_pattern(n):
+    """The stream `consbench tx n` writes, '\\n' every CONS_LINE bytes."""
+    out = bytearray(n)
+    for k in range(n):
+        if k % CONS_LINE == CONS_LINE - 1:
+            out[k] = ord("\n")
+        else:
+            out[k] = ord("a") + (k // CONS_LINE) % 26
+    return bytes(out)
+
+
+def payload(args):
+    if args.file:
+        return open(args.file, "rb").read()
+    # Printable text, so a stray byte is easy to spot in the transcript
+    line = b"the quick brown fox jumps over the lazy dog 0123456789\n"
+    return (line * (args.bytes // len(line) + 1))[:args.bytes]
+
+
+def fields_all(text, prefix):
+    return [dict(f.split("=", 1) for f in line.split() if "=" in f)
+            for line in text.splitlines() if line.startswith(prefix)]
+
+
+def fields(text, prefix):
+    found = fields_all(text, prefix)
+    return found[0] if found else None
+
+
+def converse(cmd, before, after):
+    """Feed `before`, wait for the prompt after the reboot, feed `after`.
+
+    Input the device has buffered is lost across a reset, so the second
+    half is only sent once the rebooted kernel is reading again.
+    """
+    proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    out = bytearray()
+
+    def reader():
+        while True:
+            chunk = proc.stdout.read1(65536)
+            if not chunk:
+                break
+            out.extend(chunk)
+
+    t = threading.Thread(target=reader, daemon=True)
+    t.start()
+    deadline = time.monotonic() + TIMEOUT
+    try:
+        proc.stdin.write(before)
+        proc.stdin.flush()
+        while out.count(PROMPT.encode()) < 2:
+            if proc.poll() is not None or time.monotonic() > deadline:
+                return None
+            time.sleep(0.05)
+        proc.stdin.write(after)
+        proc.stdin.close()
+        proc.wait(max(deadline - time.monotonic(), 1))
+    except (subprocess.TimeoutExpired, BrokenPipeError):
+        return None
+    finally:
+        if proc.poll() is None:
+            proc.kill()
+            proc.wait()
+        t.join()
+    return bytes(out)
+
+
+def run(kernel, backend, data):
+    n = len(data)
+    check = data[:REBOOT_CHECK]
+    before = (b"consbench rx %d\n" % n) + data + (b"consbench tx %d\nreboot\n" % n)
+    after = (b"consbench rx %d\n" % len(check)) + check + b"poweroff\n"
+    cmd = [QEMU, "-machine", "virt", "-bios", "none", "-kernel", kernel,
+           "-display", "none", "-monitor", "none"] + BACKENDS[backend]
+    out = converse(cmd, before, after)
+    if out is None:
+        return None, "timed out or exited early"
+    text = out.replace(b"\r", b"").decode("latin-1")
+
+    rx = fields(text, "bench name=cons_rx_")
+    rxsums = fields_all(text, "consbench rx hash=")
+    rxsum = rxsums[0] if rxsums else None
+    tx = fields(text, "bench name=cons_tx_")
+    txsum = fields(text, "consbench tx backend=")
+    if not (rx and rxsum and tx and txsum):
+        return None, "no consbench results"
+    if rxsum["backend"] != backend:
+        return None, "kernel picked the %s backend" % rxsum["backend"]
+    if int(rxsum["hash"], 16) != fnv1a(data):
+        return None, "rx data corrupted"
+    begin = text.find("consbench tx begin\n") + len("consbench tx begin\n")
+    end = text.find("\nconsbench tx end")
+    if text[begin:end].encode("latin-1") != tx_pattern(n):
+        return None, "tx data corrupted"
+    if len(rxsums) < 2 or int(rxsums[1]["hash"], 16) != fnv1a(check):
+        return None, "rx broken after warm reboot"
+
+    results = []
+    for name, f, s in (("rx", rx, rxsum), ("tx", tx, txsum)):
+        us = max(int(f["us"]), 1)
+        results.append((name, n, us, n / us * 1e6 / 1024, s["bufs"], s["kicks"]))
+    return results, None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("kernel")
+    ap.add_argument("--bytes", type=int, default=1 << 20)
+    ap.add_argument("--file", help="pipe this file instead of generated text")
+    ap.add_argument("--backend", choices=sorted(BACKENDS), action="append")
+    args = ap.parse_args()
+
+    data = payload(args)
+    failed = False
+    print("%-8s %-3s %10s %10s %10s %8s %8s" %
+          ("backend", "dir", "bytes", "us", "KiB/s", "bufs", "kicks"))
+    for backend in args.backend or ["uart", "virtio"]:
+        results, err = run(args.kernel, backend, data)
+        if err:
+            print("%-8s %s" % (backend, err))
+            failed = True
+            continue
+        for name, n, us, rate, bufs, kicks in results:
+            print("%-8s %-3s %10d %10d %10.0f %8s %8s" %
+                  (backend, name, n, us, rate, bufs, kicks))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Symbolize a kernel `prof dump` against `objdump -t kernel.elf` output.
+
+Usage: tools/profsym.py kernel.sym prof.log [TOP]
+
+Prints the TOP functions (default 20) by sample count. Used by
+`make prof-report`.
+"""
+
+import sys
+
+
+def load_symbols(path):
+    """Text symbols from `objdump -t`, sorted by address."""
+    syms = []
+    for line in open(path):
+        parts = line.split()
+        # 0000000080000000 g     F .text  0000000000000054 main
+        if len(parts) < 5 or ".text" not in parts:
+            continue
+        sec = parts.index(".text")
+        try:
+            addr = int(parts[0], 16)
+            size = int(parts[sec + 1], 16)
+        except (ValueError, IndexError):
+            continue
+        name = parts[-1]
+        if name.startswith(".L") or name == ".text":
+            continue
+        syms.append((addr, size, name))
+    syms.sort()
+    return syms
+
+
+def resolve(syms, pc):
+    """Innermost symbol containing pc, else the closest one below it."""
+    lo, hi = 0, len(syms)
+    while lo < hi:
+        mid = (lo + hi) // 2
+        if syms[mid][0] <= pc:
+            lo = mid + 1
+        else:
+            hi = mid
+    best = None
+    for addr, size, name in reversed(syms[:lo]):
+        if size and addr <= pc < addr + size:
+            return name
+        if best is None:
+            best = name
+        if size:
+            break
+    return best or "?"
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__.strip())
+    syms = load_symbols(sys.argv[1])
+    top = int(sys.argv[3]) if len(sys.argv) > 3 else 20
+
+    counts = {}
+    total = 0
+    outside = 0
+    for line in open(sys.argv[2], errors="replace"):
+        parts = line.split()
+        if len(parts) == 4 and parts[0] == "P":
+            pc, n = int(parts[2], 16), int(parts[3])
+            name = resolve(syms, pc)
+            counts[name] = counts.get(name, 0) + n
+            total += n
+        elif len(parts) >= 7 and parts[:2] == ["#", "hart"] and parts[5] == "outside":
+            outside += int(parts[6])
+
+    if total == 0:
+        sys.exit("no profile samples found in " + sys.argv[2])
+
+    print("%8s %7s  %s" % ("samples", "percent", "function"))
+    for name, n in sorted(counts.items(), key=lambda kv: -kv[1])[:top]:
+        print("%8d %6.2f%%  %s" % (n, 100.0 * n / total, name))
+    if outside:
+        print("(%d samples outside the histogram range)" % outside)
+
+
+if __name__ == "__main__":
+    main()
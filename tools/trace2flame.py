@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Convert a kernel `trace dump` into a flame graph input or a timeline.
+
+Capture the console output of `trace dump` (e.g. with `script` or by
+redirecting QEMU's stdio), then:
+
+    tools/trace2flame.py console.log > trace.folded      # flamegraph.pl input
+    tools/trace2flame.py --chrome console.log > trace.json  # chrome://tracing, Perfetto
+
+Folded stacks are weighted by self time in timer ticks.
+"""
+
+import argparse
+import json
+import sys
+
+
+def decode_tag(value):
+    """Undo trace_tag(): up to 8 little-endian bytes of a string."""
+    out = []
+    while value:
+        out.append(chr(value & 0xFF))
+        value >>= 8
+    return "".join(out)
+
+
+def parse(lines):
+    hz = 10_000_000
+    names = {}
+    events = []
+    inside = False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("# trace begin"):
+            inside = True
+            events = []
+            for field in line.split()[3:]:
+                if field.startswith("hz="):
+                    hz = int(field[3:])
+        elif line.startswith("# trace end"):
+            inside = False
+        elif not inside:
+            continue
+        elif line.startswith("# event "):
+            _, _, num, name = line.split(maxsplit=3)
+            names[int(num)] = name
+        elif line.startswith("T "):
+            parts = line.split()
+            if len(parts) != 7:
+                continue
+            hart, ts, ev = (int(x, 16) for x in parts[1:4])
+            arg0, arg1 = int(parts[5], 16), int(parts[6], 16)
+            events.append((hart, ts, ev, parts[4], arg0, arg1))
+    return hz, names, events
+
+
+def frame_name(names, ev, arg1):
+    name = names.get(ev, "event%d" % ev)
+    if name == "cmd" and arg1:
+        return "cmd:" + decode_tag(arg1)
+    return name
+
+
+def folded(names, events):
+    """Self time per call stack, per hart."""
+    weights = {}
+    stacks = {}
+    last = {}
+    for hart, ts, ev, phase, _arg0, arg1 in sorted(events, key=lambda e: (e[0], e[1])):
+        stack = stacks.setdefault(hart, [])
+        if stack:
+            key = ";".join(["hart%d" % hart] + [f for f, _ in stack])
+            weights[key] = weights.get(key, 0) + ts - last[hart]
+        last[hart] = ts
+        if phase == "B":
+            stack.append((frame_name(names, ev, arg1), ev))
+        elif phase == "E":
+            # Tolerate entries lost to ring wraparound
+            while stack and stack[-1][1] != ev:
+                stack.pop()
+            if stack:
+                stack.pop()
+    for key in sorted(weights):
+        if weights[key] > 0:
+            print("%s %d" % (key, weights[key]))
+
+
+def chrome(hz, names, events):
+    out = []
+    for hart, ts, ev, phase, arg0, arg1 in events:
+        rec = {
+            "name": names.get(ev, "event%d" % ev),
+            "ph": {"B": "B", "E": "E"}.get(phase, "i"),
+            "ts": ts * 1_000_000 / hz,
+            "pid": 0,
+            "tid": hart,
+            "args": {"arg0": arg0},
+        }
+        if arg1:
+            rec["args"]["tag"] = decode_tag(arg1)
+        out.append(rec)
+    json.dump({"traceEvents": out, "displayTimeUnit": "ns"}, sys.stdout)
+    print()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("log", nargs="?", help="console capture (default: stdin)")
+    ap.add_argument("--chrome", action="store_true",
+                    help="emit Chrome trace-event JSON instead of folded stacks")
+    args = ap.parse_args()
+
+    src = open(args.log, errors="replace") if args.log else sys.stdin
+    hz, names, events = parse(src)
+    if not events:
+        sys.exit("no trace dump found")
+    if args.chrome:
+        chrome(hz, names, events)
+    else:
+        folded(names, events)
+
+
+if __name__ == "__main__":
+    main()